@@ -21,10 +21,24 @@
 
 */
 
+#include <algorithm>
 #include <chrono>
 #include <math.h>
 
 #include "NIDAQComponents.h"
+#include <ProcessorHeaders.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
 
 AnalogInput::AnalogInput (String name, NIDAQ::int32 termCfgs) : InputChannel (name)
 {
@@ -44,6 +58,84 @@ AnalogInput::AnalogInput (String name, NIDAQ::int32 termCfgs) : InputChannel (na
 }
 
 static int32 GetTerminalNameWithDevPrefix (NIDAQ::TaskHandle taskHandle, const char terminalName[], char triggerName[]);
+static void logDAQmxError();
+
+/* Pins the calling thread to one core; false if the OS refused */
+static bool setCurrentThreadCore (int core, String& reason)
+{
+#if defined(_WIN32)
+    if (SetThreadAffinityMask (GetCurrentThread(), DWORD_PTR (1) << core) != 0)
+        return true;
+
+    reason = "error " + String ((int) GetLastError());
+    return false;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO (&cpus);
+    CPU_SET (core, &cpus);
+
+    int result = pthread_setaffinity_np (pthread_self(), sizeof (cpus), &cpus);
+
+    if (result == 0)
+        return true;
+
+    reason = strerror (result);
+    return false;
+#else
+    reason = "not supported on this platform";
+    return false;
+#endif
+}
+
+/* Puts the calling thread in the round-robin or FIFO real-time class; false if the OS refused */
+static bool setCurrentThreadRealtime (THREAD_PRIORITY priority, String& reason)
+{
+#if defined(_WIN32)
+    if (SetThreadPriority (GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+        return true;
+
+    reason = "error " + String ((int) GetLastError());
+    return false;
+#else
+    const int policy = priority == PRIORITY_REALTIME_FIFO ? SCHED_FIFO : SCHED_RR;
+
+    /* Stay below the very top, which belongs to kernel and audio threads */
+    sched_param param;
+    param.sched_priority = jmax (sched_get_priority_min (policy), sched_get_priority_max (policy) - 10);
+
+    int result = pthread_setschedparam (pthread_self(), policy, &param);
+
+    if (result == 0)
+        return true;
+
+    reason = result == EPERM ? "not permitted (needs CAP_SYS_NICE or an rtprio limit)" : strerror (result);
+    return false;
+#endif
+}
+
+/* CPU time consumed by the calling thread, in seconds */
+static double getThreadCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (! GetThreadTimes (GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return 0.0;
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    return double (kernel.QuadPart + user.QuadPart) * 1e-7; // 100 ns units
+#else
+    timespec t;
+    if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &t) != 0)
+        return 0.0;
+
+    return double (t.tv_sec) + double (t.tv_nsec) * 1e-9;
+#endif
+}
 
 static int32 GetTerminalNameWithDevPrefix (NIDAQ::TaskHandle taskHandle, const char terminalName[], char triggerName[])
 {
@@ -69,6 +161,41 @@ Error:
     return error;
 }
 
+/* Reads a device string property of any length; with a zero-sized buffer DAQmx returns the size it needs */
+template <typename Getter>
+static String getDeviceString (Getter getter, const String& deviceName)
+{
+    NIDAQ::int32 size = getter (STR2CHR (deviceName), NULL, 0);
+
+    if (size <= 0)
+        return {};
+
+    HeapBlock<char> data (size, true);
+
+    if (DAQmxFailed (getter (STR2CHR (deviceName), data, size)))
+        return {};
+
+    return String (data.getData());
+}
+
+/* Converts one scan of raw ADC counts to volts using each channel's device scaling polynomial */
+template <typename RawType>
+static void scaleRawScan (const RawType* scan, float* samples, const int* enabledChannels, int numEnabledChannels, const NIDAQ::float64* coeffs, int numCoeffs)
+{
+    for (int c = 0; c < numEnabledChannels; c++)
+    {
+        const int channel = enabledChannels[c];
+        const NIDAQ::float64* k = coeffs + channel * numCoeffs;
+        const NIDAQ::float64 x = scan[channel];
+
+        NIDAQ::float64 volts = 0;
+        for (int n = numCoeffs - 1; n >= 0; n--)
+            volts = volts * x + k[n];
+
+        samples[channel] = volts;
+    }
+}
+
 void NIDAQmxDeviceManager::scanForDevices()
 {
     devices.clear();
@@ -109,6 +236,11 @@ int NIDAQmxDeviceManager::getDeviceIndexFromName (String name)
     return -1;
 }
 
+NIDAQDevice* NIDAQmxDeviceManager::getDeviceFromName (String deviceName)
+{
+    return devices[getDeviceIndexFromName (deviceName)];
+}
+
 NIDAQmx::NIDAQmx (NIDAQDevice* device_)
     : Thread ("NIDAQmx-" + String (device_->getName())), device (device_)
 {
@@ -127,15 +259,31 @@ NIDAQmx::NIDAQmx (NIDAQDevice* device_)
     while (sample_rates[idx] <= device->sampleRateRange.max && idx < NUM_SAMPLE_RATES)
         sampleRates.add (sample_rates[idx++]);
 
-    // Default to highest sample rate
-    sampleRateIndex = sampleRates.size() - 1;
-
     // Default to largest voltage range
     voltageRangeIndex = device->voltageRanges.size() - 1;
+
+    // Default to highest sample rate
+    setSampleRate (sampleRates.size() - 1);
+
+    processingThread = new ProcessingThread (this);
+
+    for (int i = 0; i < PIPELINE_DEPTH; i++)
+        rawBlocks.add (new RawBlock());
 }
 
-void NIDAQmx::connect()
+NIDAQmx::~NIDAQmx()
+{
+    /* The threads and callbacks use this object's tasks and buffers until they are stopped */
+    stopAcquisition();
+}
+
+void NIDAQmxDeviceManager::probeDevice (NIDAQDevice* device)
 {
+    if (device->isProbed)
+        return;
+
+    device->isProbed = true;
+
     String deviceName = device->getName();
 
     if (deviceName == "Simulated")
@@ -144,109 +292,102 @@ void NIDAQmx::connect()
         device->sampleRateRange = SettingsRange (1000.0f, 30000.0f);
         device->voltageRanges.add (SettingsRange (-10.0f, 10.0f));
         device->productName = String ("No Device Detected");
+        return;
     }
-    else
-    {
-        /* Get category type */
-        NIDAQ::DAQmxGetDevProductCategory (STR2CHR (deviceName), &device->deviceCategory);
-        LOGD ("Product Category: ", device->deviceCategory);
 
-        device->isUSBDevice = device->productName.contains ("USB");
+    /* Get category type */
+    NIDAQ::DAQmxGetDevProductCategory (STR2CHR (deviceName), &device->deviceCategory);
+    LOGD ("Product Category: ", device->deviceCategory);
 
-        device->digitalReadSize = device->isUSBDevice ? 32 : 8;
+    device->isUSBDevice = device->productName.contains ("USB");
 
-        NIDAQ::DAQmxGetDevProductNum (STR2CHR (deviceName), &device->productNum);
-        LOGD ("Product Num: ", device->productNum);
+    device->digitalReadSize = device->isUSBDevice ? 32 : 8;
 
-        NIDAQ::DAQmxGetDevSerialNum (STR2CHR (deviceName), &device->serialNum);
-        LOGD ("Serial Num: ", device->serialNum);
+    NIDAQ::DAQmxGetDevProductNum (STR2CHR (deviceName), &device->productNum);
+    LOGD ("Product Num: ", device->productNum);
 
-        /* Get simultaneous sampling supported */
-        NIDAQ::bool32 supported = false;
-        NIDAQ::DAQmxGetDevAISimultaneousSamplingSupported (STR2CHR (deviceName), &supported);
-        device->simAISamplingSupported = supported;
-        LOGD ("Simultaneous sampling supported: ", supported ? "YES" : "NO");
+    NIDAQ::DAQmxGetDevSerialNum (STR2CHR (deviceName), &device->serialNum);
+    LOGD ("Serial Num: ", device->serialNum);
 
-        /* Get device sample rates */
-        NIDAQ::float64 smin;
-        NIDAQ::DAQmxGetDevAIMinRate (STR2CHR (deviceName), &smin);
-        LOGD ("Min sample rate: ", smin);
+    /* Get simultaneous sampling supported */
+    NIDAQ::bool32 supported = false;
+    NIDAQ::DAQmxGetDevAISimultaneousSamplingSupported (STR2CHR (deviceName), &supported);
+    device->simAISamplingSupported = supported;
+    LOGD ("Simultaneous sampling supported: ", supported ? "YES" : "NO");
 
-        NIDAQ::float64 smaxs;
-        NIDAQ::DAQmxGetDevAIMaxSingleChanRate (STR2CHR (deviceName), &smaxs);
-        LOGD ("Max single channel sample rate: ", smaxs);
+    /* Get device sample rates */
+    NIDAQ::DAQmxGetDevAIMinRate (STR2CHR (deviceName), &device->minSampleRate);
+    LOGD ("Min sample rate: ", device->minSampleRate);
 
-        NIDAQ::float64 smaxm;
-        NIDAQ::DAQmxGetDevAIMaxMultiChanRate (STR2CHR (deviceName), &smaxm);
-        LOGD ("Max multi channel sample rate: ", smaxm);
+    NIDAQ::float64 smaxs;
+    NIDAQ::DAQmxGetDevAIMaxSingleChanRate (STR2CHR (deviceName), &smaxs);
+    LOGD ("Max single channel sample rate: ", smaxs);
 
-        NIDAQ::float64 data[512];
-        NIDAQ::DAQmxGetDevAIVoltageRngs (STR2CHR (deviceName), &data[0], sizeof (data));
+    NIDAQ::DAQmxGetDevAIMaxMultiChanRate (STR2CHR (deviceName), &device->maxMultiChanRate);
+    LOGD ("Max multi channel sample rate: ", device->maxMultiChanRate);
 
-        // Get available voltage ranges
-        device->voltageRanges.clear();
-        LOGD ("Detected voltage ranges: \n");
-        for (int i = 0; i < 512; i += 2)
-        {
-            NIDAQ::float64 vmin = data[i];
-            NIDAQ::float64 vmax = data[i + 1];
-            if (vmin == vmax || abs (vmin) < 1e-10 || vmax < 1e-2)
-                break;
-            device->voltageRanges.add (SettingsRange (vmin, vmax));
-        }
+    NIDAQ::float64 data[512];
+    NIDAQ::DAQmxGetDevAIVoltageRngs (STR2CHR (deviceName), &data[0], sizeof (data));
 
-        NIDAQ::int32 error = 0;
-        char errBuff[ERR_BUFF_SIZE] = { '\0' };
+    // Get available voltage ranges
+    device->voltageRanges.clear();
+    LOGD ("Detected voltage ranges: \n");
+    for (int i = 0; i < 512; i += 2)
+    {
+        NIDAQ::float64 vmin = data[i];
+        NIDAQ::float64 vmax = data[i + 1];
+        if (vmin == vmax || abs (vmin) < 1e-10 || vmax < 1e-2)
+            break;
+        device->voltageRanges.add (SettingsRange (vmin, vmax));
+    }
 
-        char ai_channel_data[2048];
-        NIDAQ::DAQmxGetDevAIPhysicalChans (STR2CHR (device->getName()), &ai_channel_data[0], sizeof (ai_channel_data));
+    NIDAQ::int32 error = 0;
+    char errBuff[ERR_BUFF_SIZE] = { '\0' };
 
-        StringArray channel_list;
-        channel_list.addTokens (&ai_channel_data[0], ", ", "\"");
+    /* Large cards and cDAQ chassis list hundreds of channels, so the list is sized by DAQmx */
+    StringArray channel_list;
+    channel_list.addTokens (getDeviceString (NIDAQ::DAQmxGetDevAIPhysicalChans, deviceName), ", ", "\"");
 
-        device->numAIChannels = 0;
-        ai.clear();
+    device->aiChannelNames.clear();
+    device->aiTerminalConfigs.clear();
 
-        LOGD ("Detected ", channel_list.size(), " analog input channels");
+    LOGD ("Detected ", channel_list.size(), " analog input channels");
 
-        for (int i = 0; i < channel_list.size(); i++)
+    for (int i = 0; i < channel_list.size(); i++)
+    {
+        if (channel_list[i].length() > 0)
         {
-            if (channel_list[i].length() > 0)
-            {
-                /* Get channel termination */
-                NIDAQ::int32 termCfgs;
-                NIDAQ::DAQmxGetPhysicalChanAITermCfgs (channel_list[i].toUTF8(), &termCfgs);
-
-                String name = channel_list[i].toRawUTF8();
+            /* Get channel termination */
+            NIDAQ::int32 termCfgs;
+            NIDAQ::DAQmxGetPhysicalChanAITermCfgs (channel_list[i].toUTF8(), &termCfgs);
 
-                String terminalConfigurations = String::toHexString (termCfgs);
+            device->aiChannelNames.add (channel_list[i].toRawUTF8());
+            device->aiTerminalConfigs.add (termCfgs);
 
-                ai.add (new AnalogInput (name, termCfgs));
+            LOGD ("Found analog input channel: ", channel_list[i], " with terminal config: ", " (", termCfgs, ")");
+        }
+    }
 
-                if (device->numAIChannels++ <= numActiveAnalogInputs)
-                {
-                    ai.getLast()->setAvailable (true);
-                    ai.getLast()->setEnabled (true);
-                }
+    device->numAIChannels = device->aiChannelNames.size();
 
-                LOGD ("Adding analog input channel: ", name, " with terminal config: ", " (", termCfgs, ") enabled: ", ai.getLast()->isEnabled() ? "YES" : "NO");
-            }
-        }
+    // Get ADC resolution for each voltage range (throwing error as is)
+    NIDAQ::TaskHandle adcResolutionQuery = 0;
 
-        // Get ADC resolution for each voltage range (throwing error as is)
-        NIDAQ::TaskHandle adcResolutionQuery;
+    device->adcResolutions.clear();
 
-        NIDAQ::DAQmxCreateTask ("ADCResolutionQuery", &adcResolutionQuery);
+    if (device->aiChannelNames.size() > 0)
+    {
+        const String queryChannel = device->aiChannelNames[0];
 
-        SettingsRange vRange;
+        DAQmxErrChk (NIDAQ::DAQmxCreateTask ("ADCResolutionQuery", &adcResolutionQuery));
 
         for (int i = 0; i < device->voltageRanges.size(); i++)
         {
-            vRange = device->voltageRanges[i];
+            SettingsRange vRange = device->voltageRanges[i];
 
             DAQmxErrChk (NIDAQ::DAQmxCreateAIVoltageChan (
                 adcResolutionQuery, // task handle
-                STR2CHR (ai[i]->getName()), // NIDAQ physical channel name (e.g. dev1/ai1)
+                STR2CHR (queryChannel), // NIDAQ physical channel name (e.g. dev1/ai1)
                 "", // user-defined channel name (optional)
                 DAQmx_Val_Cfg_Default, // input terminal configuration
                 vRange.min, // min input voltage
@@ -255,134 +396,344 @@ void NIDAQmx::connect()
                 NULL));
 
             NIDAQ::float64 adcResolution;
-            DAQmxErrChk (NIDAQ::DAQmxGetAIResolution (adcResolutionQuery, STR2CHR (ai[i]->getName()), &adcResolution));
+            DAQmxErrChk (NIDAQ::DAQmxGetAIResolution (adcResolutionQuery, STR2CHR (queryChannel), &adcResolution));
 
             device->adcResolutions.add (adcResolution);
         }
+    }
 
-        NIDAQ::DAQmxStopTask (adcResolutionQuery);
-        NIDAQ::DAQmxClearTask (adcResolutionQuery);
-
+    {
         // Get Digital Input Channels
 
-        char di_channel_data[2048];
         // NIDAQ::DAQmxGetDevTerminals(STR2CHR(deviceName), &data[0], sizeof(data)); //gets all terminals
         // NIDAQ::DAQmxGetDevDIPorts(STR2CHR(deviceName), &data[0], sizeof(data));	//gets line name
-        NIDAQ::DAQmxGetDevDILines (STR2CHR (deviceName), &di_channel_data[0], sizeof (di_channel_data)); // gets ports on line
+        String di_channel_data = getDeviceString (NIDAQ::DAQmxGetDevDILines, deviceName); // gets ports on line
         LOGD ("Found digital inputs: ");
 
         channel_list.clear();
-        channel_list.addTokens (&di_channel_data[0], ", ", "\"");
+        channel_list.addTokens (di_channel_data, ", ", "\"");
 
+        device->diLineNames.clear();
         device->digitalPortNames.clear();
-        device->digitalPortStates.clear();
-        device->numDIChannels = 0;
-        di.clear();
 
         for (int i = 0; i < channel_list.size(); i++)
         {
-            StringArray channel_type;
-            channel_type.addTokens (channel_list[i], "/", "\"");
             if (channel_list[i].length() > 0)
             {
                 String fullName = channel_list[i].toRawUTF8();
-
-                String lineName = fullName.fromFirstOccurrenceOf ("/", false, false);
                 String portName = fullName.upToLastOccurrenceOf ("/", false, false);
 
                 // Add port to list of ports
                 if (! device->digitalPortNames.contains (portName.toRawUTF8()))
-                {
                     device->digitalPortNames.add (portName.toRawUTF8());
-                    if (device->numDIChannels < numActiveDigitalInputs)
-                        device->digitalPortStates.add (true);
-                    else
-                        device->digitalPortStates.add (false);
-                }
 
-                di.add (new InputChannel (fullName));
+                device->diLineNames.add (fullName);
+            }
+        }
+
+        device->numDIChannels = device->diLineNames.size();
+    }
 
-                di.getLast()->setAvailable (true);
-                if (device->numDIChannels < numActiveDigitalInputs)
-                    di.getLast()->setEnabled (true);
+Error:
 
-                device->numDIChannels++;
-            }
+    if (DAQmxFailed (error))
+        NIDAQ::DAQmxGetExtendedErrorInfo (errBuff, ERR_BUFF_SIZE);
+
+    if (adcResolutionQuery != 0)
+    {
+        // DAQmx Stop Code
+        NIDAQ::DAQmxStopTask (adcResolutionQuery);
+        NIDAQ::DAQmxClearTask (adcResolutionQuery);
+    }
+
+    if (DAQmxFailed (error))
+        LOGE ("DAQmx Error: ", errBuff);
+    fflush (stdout);
+}
+
+void NIDAQmx::connect()
+{
+    /* Probing is shared by every acquisition of the same device, so only the first one talks to DAQmx */
+    NIDAQmxDeviceManager::probeDevice (device);
+
+    ai.clear();
+
+    for (int i = 0; i < device->aiChannelNames.size(); i++)
+    {
+        ai.add (new AnalogInput (device->aiChannelNames[i], device->aiTerminalConfigs[i]));
+
+        if (i <= numActiveAnalogInputs)
+        {
+            ai.getLast()->setAvailable (true);
+            ai.getLast()->setEnabled (true);
+        }
+    }
+
+    di.clear();
+    device->digitalPortStates.clear();
+
+    StringArray portsSeen;
+
+    for (int i = 0; i < device->diLineNames.size(); i++)
+    {
+        const String fullName = device->diLineNames[i];
+        const String portName = fullName.upToLastOccurrenceOf ("/", false, false);
+
+        // Ports start enabled if their first line is among the active inputs
+        if (! portsSeen.contains (portName))
+        {
+            portsSeen.add (portName);
+            device->digitalPortStates.add (i < numActiveDigitalInputs);
         }
 
-        // Set sample rate range
-        NIDAQ::float64 smax = smaxm;
+        di.add (new InputChannel (fullName));
+
+        di.getLast()->setAvailable (true);
+        if (i < numActiveDigitalInputs)
+            di.getLast()->setEnabled (true);
+    }
+
+    // Set sample rate range
+    if (device->maxMultiChanRate > 0)
+    {
+        NIDAQ::float64 smax = device->maxMultiChanRate;
         if (! device->simAISamplingSupported)
             smax /= numActiveAnalogInputs;
 
-        device->sampleRateRange = SettingsRange (smin, smax);
+        device->sampleRateRange = SettingsRange (device->minSampleRate, smax);
+    }
+}
 
-    Error:
+void NIDAQmx::setSampleRate (int index)
+{
+    sampleRateIndex = index;
 
-        if (DAQmxFailed (error))
-            NIDAQ::DAQmxGetExtendedErrorInfo (errBuff, ERR_BUFF_SIZE);
+    requestedSampleRate = sampleRates[index];
+    updateSampleRate();
+}
+
+void NIDAQmx::setCustomSampleRate (NIDAQ::float64 rate)
+{
+    requestedSampleRate = jlimit (NIDAQ::float64 (device->sampleRateRange.min), NIDAQ::float64 (device->sampleRateRange.max), rate);
+    sampleRateIndex = sampleRates.indexOf (requestedSampleRate);
+
+    updateSampleRate();
+}
+
+void NIDAQmx::setNumActiveAnalogInputs (int numActiveAnalogInputs_)
+{
+    numActiveAnalogInputs = numActiveAnalogInputs_;
+
+    /* Multiplexed devices share the convert clock between channels, so the rate can change */
+    updateSampleRate();
+}
+
+void NIDAQmx::updateSampleRate()
+{
+    const int numChannels = jmin (numActiveAnalogInputs, ai.size());
 
-        if (adcResolutionQuery != 0)
+    for (auto& entry : device->coercedSampleRates)
+    {
+        if (entry.requested == requestedSampleRate && entry.numChannels == numChannels)
         {
-            // DAQmx Stop Code
-            NIDAQ::DAQmxStopTask (adcResolutionQuery);
-            NIDAQ::DAQmxClearTask (adcResolutionQuery);
+            sampleRate = entry.coerced;
+            return;
         }
+    }
 
-        if (DAQmxFailed (error))
-            LOGE ("DAQmx Error: ", errBuff);
-        fflush (stdout);
+    const NIDAQ::float64 coercedRate = queryCoercedSampleRate (requestedSampleRate, numChannels);
 
-        return;
+    /* A failed query is retried next time rather than remembered */
+    if (coercedRate > 0)
+        device->coercedSampleRates.add ({ requestedSampleRate, numChannels, coercedRate });
+
+    sampleRate = coercedRate > 0 ? coercedRate : requestedSampleRate;
+}
+
+NIDAQ::float64 NIDAQmx::queryCoercedSampleRate (NIDAQ::float64 rate, int numChannels)
+{
+    if (numChannels == 0 || device->voltageRanges.size() == 0)
+        return rate;
+
+    NIDAQ::int32 error = 0;
+    NIDAQ::TaskHandle rateQuery = 0;
+    NIDAQ::float64 coercedRate = rate;
+
+    SettingsRange vRange = device->voltageRanges.getLast();
+
+    DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("SampleRateQuery" + getSerialNumber()), &rateQuery));
+
+    for (int i = 0; i < numChannels; i++)
+        DAQmxErrChk (NIDAQ::DAQmxCreateAIVoltageChan (
+            rateQuery,
+            STR2CHR (ai[i]->getName()),
+            "",
+            DAQmx_Val_Cfg_Default,
+            vRange.min,
+            vRange.max,
+            DAQmx_Val_Volts,
+            NULL));
+
+    DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (rateQuery, "", rate, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000));
+
+    /* The clock divisor is only resolved once the task is committed */
+    DAQmxErrChk (NIDAQ::DAQmxTaskControl (rateQuery, DAQmx_Val_Task_Commit));
+    DAQmxErrChk (NIDAQ::DAQmxGetSampClkRate (rateQuery, &coercedRate));
+
+    if (coercedRate != rate)
+        LOGC ("NIDAQmx: ", device->getName(), " cannot sample ", numChannels, " inputs at ", rate, " S/s, the sample clock will run at ", coercedRate, " S/s");
+
+Error:
+
+    if (DAQmxFailed (error))
+    {
+        logDAQmxError();
+        coercedRate = 0;
     }
+
+    if (rateQuery != 0)
+        NIDAQ::DAQmxClearTask (rateQuery);
+
+    return coercedRate;
 }
 
-uint32 NIDAQmx::getActiveDigitalLines()
+/* Volts per count of a raw-to-volts polynomial, or 0 when the recorded 16-bit samples cannot hold
+   one count per value: a step too fine for the range, or higher orders that bend the curve by half
+   a count or more anywhere across it */
+static NIDAQ::float64 getUniformCountStep (const NIDAQ::float64* coeffs, int numCoeffs, SettingsRange range)
 {
-    if (! getNumActiveDigitalInputs())
+    if (numCoeffs < 2 || coeffs[1] == 0)
         return 0;
 
-    uint32 linesEnabled = 0;
-    for (int i = 0; i < di.size(); i++)
+    const NIDAQ::float64 step = fabs (coeffs[1]);
+    const NIDAQ::float64 numCounts = (range.max - range.min) / step;
+
+    if (numCounts > 65536.0)
+        return 0;
+
+    NIDAQ::float64 bend = 0;
+    NIDAQ::float64 power = numCounts;
+
+    for (int k = 2; k < numCoeffs; k++)
     {
-        if (di[i]->isEnabled())
-            linesEnabled += pow (2, i);
+        power *= numCounts;
+        bend += fabs (coeffs[k]) * power;
     }
-    return linesEnabled;
+
+    return bend < 0.5 * step ? step : 0;
 }
 
-void NIDAQmx::run()
+Array<NIDAQ::float64> NIDAQmx::queryRawCountSteps (int rangeIndex)
 {
-    /* Derived from NIDAQmx: ANSI C Example program: ContAI-ReadDigChan.c */
-
-    /* Single task to handle all analog inputs */
-    NIDAQ::TaskHandle taskHandleAI = 0;
+    Array<NIDAQ::float64> steps;
 
-    /* Potentially multiple tasks to handle different digital line properties */
-    std::vector<NIDAQ::TaskHandle> taskHandlesDI = std::vector<NIDAQ::TaskHandle>();
+    if (ai.size() == 0 || rangeIndex >= device->voltageRanges.size())
+        return steps;
 
     NIDAQ::int32 error = 0;
-    char errBuff[ERR_BUFF_SIZE] = { '\0' };
+    NIDAQ::TaskHandle scalingQuery = 0;
+    NIDAQ::float64 coeffs[MAX_SCALING_COEFFS];
+    int numCoeffs = 0;
 
-    /**************************************/
-    /********CONFIG ANALOG CHANNELS********/
-    /**************************************/
+    SettingsRange vRange = device->voltageRanges[rangeIndex];
 
-    NIDAQ::int32 ai_read = 0;
-    static int totalAIRead = 0;
+    DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("RawScalingQuery" + getSerialNumber()), &scalingQuery));
 
-    aiBuffer->clear();
-    ai_data.malloc (CHANNEL_BUFFER_SIZE * numActiveAnalogInputs, sizeof (NIDAQ::float64));
+    for (int i = 0; i < ai.size(); i++)
+        DAQmxErrChk (NIDAQ::DAQmxCreateAIVoltageChan (
+            scalingQuery,
+            STR2CHR (ai[i]->getName()),
+            "",
+            DAQmx_Val_Cfg_Default,
+            vRange.min,
+            vRange.max,
+            DAQmx_Val_Volts,
+            NULL));
 
-    eventCodes.malloc (CHANNEL_BUFFER_SIZE, sizeof (NIDAQ::uInt32));
+    /* The calibration for the range is only loaded once the task is committed */
+    DAQmxErrChk (NIDAQ::DAQmxTaskControl (scalingQuery, DAQmx_Val_Task_Commit));
 
-    /* Create an analog input task */
-    if (device->isUSBDevice)
-        DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("AITask_USB" + getSerialNumber()), &taskHandleAI));
-    else
-        DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("AITask_PXI" + getSerialNumber()), &taskHandleAI));
+    numCoeffs = jlimit (0, MAX_SCALING_COEFFS, int (NIDAQ::DAQmxGetAIDevScalingCoeff (scalingQuery, STR2CHR (ai[0]->getName()), NULL, 0)));
+
+    for (int i = 0; i < ai.size(); i++)
+    {
+        DAQmxErrChk (NIDAQ::DAQmxGetAIDevScalingCoeff (scalingQuery, STR2CHR (ai[i]->getName()), coeffs, numCoeffs));
+        steps.add (getUniformCountStep (coeffs, numCoeffs, vRange));
+    }
+
+Error:
+
+    if (DAQmxFailed (error))
+    {
+        logDAQmxError();
+        steps.clear();
+    }
+
+    if (scalingQuery != 0)
+        NIDAQ::DAQmxClearTask (scalingQuery);
+
+    return steps;
+}
+
+NIDAQ::float64 NIDAQmx::getRawCountStep (int channel)
+{
+    for (auto& entry : device->rawCountSteps)
+    {
+        if (entry.rangeIndex == voltageRangeIndex)
+            return entry.steps[channel];
+    }
+
+    /* Kept even when the query fails (no steps), so the driver is not asked again for every channel */
+    const Array<NIDAQ::float64> steps = queryRawCountSteps (voltageRangeIndex);
+    device->rawCountSteps.add ({ voltageRangeIndex, steps });
+
+    return steps[channel];
+}
+
+NIDAQ::float64 NIDAQmx::getBitVolts (int channel, bool decimated)
+{
+    SettingsRange range = getVoltageRange();
+
+    /* Recorded samples are 16-bit, so no step is finer than the range over 16 bits. Unfiltered raw
+       counts are scaled by the channel's own polynomial, so where that is a uniform step its first
+       order coefficient records every count exactly; scaled volts and filtered or decimated samples
+       fall anywhere in between and keep the 16-bit step. */
+    const NIDAQ::float64 rangeStep = (range.max - range.min) / 65536.0;
+
+    const bool rawCounts = useRawSamples && ! decimated && highPassCutoff <= 0 && notchFrequency <= 0;
+
+    if (! rawCounts)
+        return rangeStep;
+
+    const NIDAQ::float64 countStep = getRawCountStep (channel);
+
+    return countStep > 0 ? countStep : rangeStep;
+}
+
+uint32 NIDAQmx::getActiveDigitalLines()
+{
+    if (! getNumActiveDigitalInputs())
+        return 0;
+
+    uint32 linesEnabled = 0;
+    for (int i = 0; i < di.size(); i++)
+    {
+        if (di[i]->isEnabled())
+            linesEnabled |= 1u << i;
+    }
+    return linesEnabled;
+}
+
+void NIDAQmx::createAcquisitionPlan()
+{
+    AcquisitionPlan newPlan;
+
+    newPlan.sampleRate = getSampleRate();
+    newPlan.voltageRange = getVoltageRange();
+
+    /* Analog inputs */
+    newPlan.numAnalogInputs = numActiveAnalogInputs;
 
-    /* Create a voltage channel for each analog input */
     for (int i = 0; i < numActiveAnalogInputs; i++)
     {
         NIDAQ::int32 termConfig;
@@ -406,284 +757,1759 @@ void NIDAQmx::run()
                 break;
         }
 
-        SettingsRange voltageRange = device->voltageRanges[voltageRangeIndex];
+        newPlan.analogChannelNames.add (ai[i]->getName());
+        newPlan.terminalConfigs.add (termConfig);
 
-        DAQmxErrChk (NIDAQ::DAQmxCreateAIVoltageChan (
-            taskHandleAI, // task handle
-            STR2CHR (ai[i]->getName()), // NIDAQ physical channel name (e.g. dev1/ai1)
-            "", // user-defined channel name (optional)
-            termConfig, // input terminal configuration
-            voltageRange.min, // min input voltage
-            voltageRange.max, // max input voltage
-            DAQmx_Val_Volts, // voltage units
-            NULL));
-    }
-
-    /* Configure sample clock timing */
-    DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (
-        taskHandleAI,
-        "", // source : NULL means use internal clock
-        getSampleRate(), // rate : samples per second per channel
-        DAQmx_Val_Rising, // activeEdge : (DAQmc_Val_Rising || DAQmx_Val_Falling)
-        DAQmx_Val_ContSamps, // sampleMode : (DAQmx_Val_FiniteSamps || DAQmx_Val_ContSamps || DAQmx_Val_HWTimedSinglePoint)
-        numActiveAnalogInputs * CHANNEL_BUFFER_SIZE)); // sampsPerChanToAcquire :
-    // If sampleMode == DAQmx_Val_FiniteSamps : # of samples to acquire for each channel
-    // Elif sampleMode == DAQmx_Val_ContSamps : circular buffer size
-
-    /* Get handle to analog trigger to sync with digital inputs */
-    char trigName[256];
-    DAQmxErrChk (GetTerminalNameWithDevPrefix (taskHandleAI, "ai/SampleClock", trigName));
+        if (ai[i]->isEnabled())
+            newPlan.enabledAnalogChannels.add (i);
 
-    /************************************/
-    /********CONFIG DIGITAL LINES********/
-    /************************************/
+        newPlan.analogEnableMasks.add (ai[i]->isEnabled() ? 0xffffffff : 0);
+    }
 
-    NIDAQ::int32 di_read = 0;
-    static int totalDIRead = 0;
+    newPlan.useRawSamples = useRawSamples;
+    newPlan.useCallbacks = useCallbacks && ! lowLatency && numActiveAnalogInputs > 0; // single points are read from the acquisition thread
+    newPlan.lowLatency = lowLatency;
+    newPlan.threadPriority = threadPriority;
+    newPlan.cpuCore = cpuCore < SystemStats::getNumCpus() ? cpuCore : -1;
+    newPlan.writeClockAnchors = writeClockAnchors;
+    newPlan.traceAcquisition = traceAcquisition;
+    newPlan.writeLatencyHistograms = writeLatencyHistograms;
+    newPlan.decimationFactor = numActiveAnalogInputs ? decimationFactor : 1;
+    newPlan.decimationTaps = decimationTaps;
+    newPlan.highPassCutoff = highPassCutoff;
+    newPlan.notchFrequency = notchFrequency;
+
+    /* Digital inputs */
+    newPlan.digitalLineMask = getActiveDigitalLines();
+    newPlan.digitalReadSize = digitalReadSize;
 
     if (numActiveDigitalInputs)
     {
-        LOGD ("Active digital mask: ", getActiveDigitalLines());
-
-        char ports[2048];
-        NIDAQ::DAQmxGetDevDIPorts (STR2CHR (device->getName()), &ports[0], sizeof (ports));
-
-        LOGD ("Detected ports: ", ports);
-
         StringArray port_list;
-        port_list.addTokens (&ports[0], ", ", "\"");
-
-        for (int i = 0; i < device->digitalPortNames.size(); i++)
-            LOGD (device->digitalPortNames[i], " : ", device->digitalPortStates[i]);
+        port_list.addTokens (getDeviceString (NIDAQ::DAQmxGetDevDIPorts, device->getName()), ", ", "\"");
 
         int portIdx = 0;
         for (auto& port : port_list)
         {
-            if (port.length() && portIdx < di.size() / PORT_SIZE && device->digitalPortStates[portIdx])
+            if (! port.length())
+                continue;
+
+            if (portIdx < di.size() / PORT_SIZE && device->digitalPortStates[portIdx])
             {
-                NIDAQ::TaskHandle taskHandleDI = 0;
-                /* Create a digital input task using device serial number to gurantee unique task name per device */
-                if (device->isUSBDevice)
-                    DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("DITask_USB" + getSerialNumber() + "port" + std::to_string (portIdx)), &taskHandleDI));
-                else
-                    DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("DITask_PXI" + getSerialNumber() + "port" + std::to_string (portIdx)), &taskHandleDI));
-
-                /* Create a channel for each digital input */
-                DAQmxErrChk (NIDAQ::DAQmxCreateDIChan (
-                    taskHandleDI,
-                    STR2CHR (port),
-                    "",
-                    DAQmx_Val_ChanForAllLines));
-
-                /* In general, only Port0 supports hardware timing */
-                if (portIdx == 0)
-                {
-                    if (numActiveAnalogInputs && numActiveDigitalInputs) // USB devices do not have an internal clock and instead use CPU, so we can't configure the sample clock timing
-                        DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (
-                            taskHandleDI, // task handle
-                            trigName, // source : NULL means use internal clock, we will sync to analog input clock
-                            getSampleRate(), // rate : samples per second per channel
-                            DAQmx_Val_Rising, // activeEdge : (DAQmc_Val_Rising || DAQmx_Val_Falling)
-                            DAQmx_Val_ContSamps, // sampleMode : (DAQmx_Val_FiniteSamps || DAQmx_Val_ContSamps || DAQmx_Val_HWTimedSinglePoint)
-                            CHANNEL_BUFFER_SIZE)); // sampsPerChanToAcquire : want to sync with analog samples per channel
-                    // If sampleMode == Dmx_Val_FiniteSamps : # of samples to acquire for each channel
-                    // Elif sampleMode == DAQAQmx_Val_ContSamps : circular buffer size
-                }
-
-                taskHandlesDI.push_back (taskHandleDI);
+                newPlan.digitalPortNames.add (port);
+                newPlan.digitalPortIndices.add (portIdx);
+                newPlan.digitalPortShifts.add (PORT_SIZE * portIdx);
             }
 
-            if (port.length())
-                portIdx++;
+            portIdx++;
         }
     }
 
-    LOGD ("Is USB Device: ", device->isUSBDevice);
+    if (useCallbacks && ! lowLatency && ! newPlan.useCallbacks)
+        LOGC ("NIDAQmx: callback mode needs at least one analog input, using the acquisition thread");
 
-    // This order is necessary to get the timing right
-    if (numActiveAnalogInputs)
-        DAQmxErrChk (NIDAQ::DAQmxTaskControl (taskHandleAI, DAQmx_Val_Task_Commit));
-    if (numActiveDigitalInputs)
+    /* Read sizes (low-latency reads drop to a single scan if the device accepts single-point timing) */
+    if (lowLatency)
     {
-        for (auto& taskHandleDI : taskHandlesDI)
-            DAQmxErrChk (NIDAQ::DAQmxTaskControl (taskHandleDI, DAQmx_Val_Task_Commit));
-    }
+        newPlan.samplesPerRead = jmax (1, roundToInt (newPlan.sampleRate * LOW_LATENCY_BLOCK_MS / 1000.0));
+        newPlan.maxSamplesPerRead = newPlan.samplesPerRead;
+        newPlan.singlePoint = numActiveAnalogInputs > 0 && probeSinglePointTiming (newPlan);
 
-    if (numActiveDigitalInputs)
+        if (newPlan.singlePoint)
+            newPlan.samplesPerRead = 1;
+    }
+    else
+    {
+        newPlan.samplesPerRead = jmax (1, roundToInt (newPlan.sampleRate * targetLatencyMs / 1000.0));
+        newPlan.maxSamplesPerRead = adaptiveReads ? newPlan.samplesPerRead * MAX_READ_SIZE_FACTOR : newPlan.samplesPerRead;
+    }
+
+    /* The DataBuffer only takes what fits, so larger blocks would lose samples without a gap */
+    if (newPlan.maxSamplesPerRead > MAX_SAMPLES_PER_READ)
+    {
+        newPlan.maxSamplesPerRead = MAX_SAMPLES_PER_READ;
+        newPlan.samplesPerRead = jmin (newPlan.samplesPerRead, MAX_SAMPLES_PER_READ);
+
+        LOGC ("NIDAQmx: reads are limited to ", MAX_SAMPLES_PER_READ, " samples per channel (", newPlan.samplesPerRead, " per read, ", newPlan.maxSamplesPerRead, " when catching up)");
+    }
+
+    newPlan.analogReadSize = newPlan.numAnalogInputs * newPlan.maxSamplesPerRead;
+    newPlan.readTimeout = jmax (READ_WATCHDOG_SECONDS, 4.0 * newPlan.maxSamplesPerRead / newPlan.sampleRate);
+    newPlan.bufferSize = jmax (int (ceil (newPlan.sampleRate * bufferSeconds)), 2 * newPlan.maxSamplesPerRead);
+
+    LOGD ("Target latency ", targetLatencyMs, " ms: ", newPlan.samplesPerRead, " samples per read", adaptiveReads ? " (adaptive)" : "");
+
+    acquisitionPlan = newPlan;
+}
+
+/* Logs the extended description of the last DAQmx error */
+static void logDAQmxError()
+{
+    char errBuff[ERR_BUFF_SIZE] = { '\0' };
+    NIDAQ::DAQmxGetExtendedErrorInfo (errBuff, ERR_BUFF_SIZE);
+    LOGE ("DAQmx Error: ", errBuff);
+}
+
+NIDAQ::int32 CVICALLBACK NIDAQmx::everyNSamplesCallback (NIDAQ::TaskHandle taskHandle, NIDAQ::int32 everyNsamplesEventType, NIDAQ::uInt32 nSamples, void* callbackData)
+{
+    return ((NIDAQmx*) callbackData)->handleSamplesReady (nSamples);
+}
+
+NIDAQ::int32 NIDAQmx::handleSamplesReady (NIDAQ::uInt32 nSamples)
+{
+    const ScopedLock lock (callbackLock);
+
+    if (! callbacksEnabled)
+        return 0;
+
+    /* The samples are already in the buffer, so the analog read returns immediately;
+       the digital tasks share the analog sample clock and may trail it very slightly */
+    const int64 loopStart = Time::getHighResolutionTicks();
+
+    NIDAQ_TRACE_SCOPE (readerTrace, "callback");
+
+    updateBufferOccupancy();
+
+    RawBlock& block = *rawBlocks[0];
+    NIDAQ::int32 error = readBlock (block, jmin (int (nSamples), plan.samplesPerRead), 1.0);
+
+    if (DAQmxFailed (error))
+    {
+        /* Recovered on the acquisition thread, which restarts the tasks */
+        logDAQmxError();
+        callbacksEnabled = false;
+        callbackError = error;
+        notify();
+        return error;
+    }
+
+    block.gapBefore = pendingGap;
+    pendingGap = 0;
+
+    samplesReadThisTask += block.numSamples;
+    lastGoodReadTime = block.readTime;
+
+    recordReadTime (block.numSamples);
+
+    processBlock (block);
+
+    stats.recordLoop (Time::getHighResolutionTicks() - loopStart);
+
+    return 0;
+}
+
+bool NIDAQmx::startAcquisition()
+{
+    if (isThreadRunning() || processingThread->isThreadRunning())
+    {
+        LOGE ("NIDAQmx: the previous run of ", device->getName(), " has not finished, not starting");
+        return false;
+    }
+
+    if (! plan.useCallbacks)
+    {
+        startThread();
+        return true;
+    }
+
+    if (plan.threadPriority != PRIORITY_NORMAL || plan.cpuCore >= 0)
+        LOGC ("NIDAQmx: thread priority and CPU pinning do not apply in callback mode (callbacks run on a DAQmx thread)");
+
+    prepareBlocks();
+
+    if (! createTasks())
+        return false;
+
+    callbacksEnabled = true;
+    callbackError = 0;
+
+    if (! startTasks())
+    {
+        callbacksEnabled = false;
+        clearTasks();
+        return false;
+    }
+
+    /* Watches the callbacks and restarts the tasks when they fail or stop arriving */
+    startThread();
+
+    return true;
+}
+
+/* Returns once the run has finished: tasks cleared and its files written */
+void NIDAQmx::stopAcquisition()
+{
+    if (isThreadRunning())
+    {
+        signalThreadShouldExit();
+        notify(); // ends a restart backoff early
+
+        /* Never killed: a thread killed inside a DAQmx call or holding callbackLock would leak
+           the tasks. Reads time out and the restart backoff wakes on notify(), so the wait is
+           only long while a driver call is still returning */
+        if (! waitForThreadToExit (STOP_TIMEOUT_MS))
+        {
+            LOGC ("NIDAQmx: acquisition thread of ", device->getName(), " still running after ", STOP_TIMEOUT_MS, " ms, waiting for it to finish");
+            waitForThreadToExit (-1);
+        }
+    }
+
+    /* Already joined by the reader before it exits, so this returns at once */
+    processingThread->waitForThreadToExit (-1);
+}
+
+/* Buffers for the whole run, allocated before the tasks are created: restarting the tasks
+   after a failure leaves them alone, since the processing thread may still be using them */
+void NIDAQmx::prepareBlocks()
+{
+    const int numAnalogInputs = plan.numAnalogInputs;
+    const int numSampsPerChan = plan.maxSamplesPerRead;
+
+    hostBufferSize = 0;
+    bufferOccupancy = 0;
+    peakBufferOccupancy = 0;
+    recentBufferPeak = 0;
+
+    dataBufferFill = 0;
+    peakDataBufferFill = 0;
+    recentDataBufferPeak = 0;
+
+    aiBuffer->clear();
+
+    for (auto& block : rawBlocks)
+    {
+        if (plan.useRawSamples)
+            block->ai_raw.malloc (plan.analogReadSize, sizeof (NIDAQ::int32));
+        else
+            block->ai_data.malloc (plan.analogReadSize, sizeof (NIDAQ::float64));
+
+        block->eventCodes.malloc (numSampsPerChan, sizeof (NIDAQ::uInt32));
+        block->numSamples = 0;
+    }
+
+    /* Disabled channels are never written, so they stay at zero */
+    aiBlock.calloc (plan.analogReadSize, sizeof (float));
+    sampleNumbers.malloc (numSampsPerChan, sizeof (int64));
+    timestamps.calloc (numSampsPerChan, sizeof (double));
+    eventCodeBlock.malloc (numSampsPerChan, sizeof (uint64));
+
+    di_data.malloc (numSampsPerChan * jmax (1, plan.digitalPortNames.size()), sizeof (NIDAQ::uInt32));
+
+    transitionIndices.malloc (numSampsPerChan, sizeof (int));
+    transitionWords.malloc (numSampsPerChan, sizeof (uint32));
+
+    if (plan.decimationFactor > 1 && decimatedBuffer != nullptr)
+    {
+        const int maxDecimatedSamples = numSampsPerChan / plan.decimationFactor + 1;
+
+        decimator.prepare (numAnalogInputs, plan.decimationFactor, plan.decimationTaps, numSampsPerChan);
+
+        decimatedBlock.malloc (maxDecimatedSamples * numAnalogInputs, sizeof (float));
+        decimatedIndices.malloc (maxDecimatedSamples, sizeof (int));
+        decimatedSampleNumbers.malloc (maxDecimatedSamples, sizeof (int64));
+        decimatedTimestamps.malloc (maxDecimatedSamples, sizeof (double));
+        decimatedEventCodes.malloc (maxDecimatedSamples, sizeof (uint64));
+
+        decimatedBuffer->clear();
+
+        LOGD ("Decimating by ", plan.decimationFactor, " with a ", plan.decimationTaps, "-tap filter (", getSIMDLevelName (decimator.getSIMDLevel()), ")");
+    }
+}
+
+bool NIDAQmx::createTasks()
+{
+    /* Derived from NIDAQmx: ANSI C Example program: ContAI-ReadDigChan.c */
+
+    NIDAQ::int32 error = 0;
+
+    /**************************************/
+    /********CONFIG ANALOG CHANNELS********/
+    /**************************************/
+
+    const int numAnalogInputs = plan.numAnalogInputs;
+
+    taskHandleAI = 0;
+    taskHandlesDI.clear();
+
+    rawSampleSize = 16;
+    taskSampleRate = plan.sampleRate;
+
+    /* Create an analog input task */
+    if (device->isUSBDevice)
+        DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("AITask_USB" + getSerialNumber()), &taskHandleAI));
+    else
+        DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("AITask_PXI" + getSerialNumber()), &taskHandleAI));
+
+    /* Create a voltage channel for each analog input */
+    for (int i = 0; i < numAnalogInputs; i++)
+    {
+        DAQmxErrChk (NIDAQ::DAQmxCreateAIVoltageChan (
+            taskHandleAI, // task handle
+            STR2CHR (plan.analogChannelNames[i]), // NIDAQ physical channel name (e.g. dev1/ai1)
+            "", // user-defined channel name (optional)
+            plan.terminalConfigs[i], // input terminal configuration
+            plan.voltageRange.min, // min input voltage
+            plan.voltageRange.max, // max input voltage
+            DAQmx_Val_Volts, // voltage units
+            NULL));
+    }
+
+    /* Configure sample clock timing */
+    if (plan.singlePoint)
+        DAQmxErrChk (configureSinglePointTiming (taskHandleAI, plan.sampleRate));
+    else
+        DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (
+            taskHandleAI,
+            "", // source : NULL means use internal clock
+            plan.sampleRate, // rate : samples per second per channel
+            DAQmx_Val_Rising, // activeEdge : (DAQmc_Val_Rising || DAQmx_Val_Falling)
+            DAQmx_Val_ContSamps, // sampleMode : (DAQmx_Val_FiniteSamps || DAQmx_Val_ContSamps || DAQmx_Val_HWTimedSinglePoint)
+            plan.bufferSize)); // sampsPerChanToAcquire :
+    // If sampleMode == DAQmx_Val_FiniteSamps : # of samples to acquire for each channel
+    // Elif sampleMode == DAQmx_Val_ContSamps : circular buffer size
+
+    /* Size the host buffer explicitly: the driver default is far smaller than a GUI stall
+       (single-point tasks have no buffer) */
+    if (numAnalogInputs && ! plan.singlePoint)
+        DAQmxErrChk (NIDAQ::DAQmxCfgInputBuffer (taskHandleAI, plan.bufferSize));
+
+    /* Callback mode: DAQmx calls back every time a full read is in the buffer */
+    if (plan.useCallbacks)
+        DAQmxErrChk (NIDAQ::DAQmxRegisterEveryNSamplesEvent (
+            taskHandleAI,
+            DAQmx_Val_Acquired_Into_Buffer,
+            plan.samplesPerRead,
+            0, // options : 0 runs the callback on a DAQmx thread
+            everyNSamplesCallback,
+            this));
+
+    /* Get handle to analog trigger to sync with digital inputs */
+    char trigName[256];
+    DAQmxErrChk (GetTerminalNameWithDevPrefix (taskHandleAI, "ai/SampleClock", trigName));
+
+    /************************************/
+    /********CONFIG DIGITAL LINES********/
+    /************************************/
+
+    LOGD ("Active digital mask: ", plan.digitalLineMask);
+
+    /* Read every enabled port through one task when the device can clock them all;
+       otherwise only port 0 is hardware timed, and each port gets its own task */
+    multiPortDI = plan.digitalPortNames.size() > 1 && numAnalogInputs && createMultiPortDITask (trigName);
+
+    if (! multiPortDI)
+    {
+        for (int i = 0; i < plan.digitalPortNames.size(); i++)
+        {
+            const int portIdx = plan.digitalPortIndices[i];
+
+            NIDAQ::TaskHandle taskHandleDI = 0;
+            /* Create a digital input task using device serial number to gurantee unique task name per device */
+            if (device->isUSBDevice)
+                DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("DITask_USB" + getSerialNumber() + "port" + std::to_string (portIdx)), &taskHandleDI));
+            else
+                DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("DITask_PXI" + getSerialNumber() + "port" + std::to_string (portIdx)), &taskHandleDI));
+
+            /* Create a channel for each digital input */
+            DAQmxErrChk (NIDAQ::DAQmxCreateDIChan (
+                taskHandleDI,
+                STR2CHR (plan.digitalPortNames[i]),
+                "",
+                DAQmx_Val_ChanForAllLines));
+
+            /* In general, only Port0 supports hardware timing */
+            if (portIdx == 0)
+            {
+                if (numAnalogInputs) // USB devices do not have an internal clock and instead use CPU, so we can't configure the sample clock timing
+                    DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (
+                        taskHandleDI, // task handle
+                        trigName, // source : NULL means use internal clock, we will sync to analog input clock
+                        plan.sampleRate, // rate : samples per second per channel
+                        DAQmx_Val_Rising, // activeEdge : (DAQmc_Val_Rising || DAQmx_Val_Falling)
+                        plan.singlePoint ? DAQmx_Val_HWTimedSinglePoint : DAQmx_Val_ContSamps, // sampleMode : follows the analog task
+                        plan.bufferSize)); // sampsPerChanToAcquire : same circular buffer as the analog task
+                // If sampleMode == Dmx_Val_FiniteSamps : # of samples to acquire for each channel
+                // Elif sampleMode == DAQAQmx_Val_ContSamps : circular buffer size
+
+                if (numAnalogInputs && ! plan.singlePoint)
+                    DAQmxErrChk (NIDAQ::DAQmxCfgInputBuffer (taskHandleDI, plan.bufferSize));
+            }
+
+            taskHandlesDI.push_back (taskHandleDI);
+        }
+    }
+
+    LOGD ("Is USB Device: ", device->isUSBDevice);
+
+    // This order is necessary to get the timing right
+    if (numAnalogInputs)
+        DAQmxErrChk (NIDAQ::DAQmxTaskControl (taskHandleAI, DAQmx_Val_Task_Commit));
+
+    /* The stream already announced the coerced rate; check that the committed task agrees */
+    if (numAnalogInputs)
+    {
+        DAQmxErrChk (NIDAQ::DAQmxGetSampClkRate (taskHandleAI, &taskSampleRate));
+
+        if (taskSampleRate != plan.sampleRate)
+            LOGC ("NIDAQmx: sample clock runs at ", taskSampleRate, " S/s, not the ", plan.sampleRate, " S/s reported to the stream");
+    }
+
+    if (numAnalogInputs && ! plan.singlePoint)
+    {
+        NIDAQ::uInt32 bufferSize = 0;
+        DAQmxErrChk (NIDAQ::DAQmxGetBufInputBufSize (taskHandleAI, &bufferSize));
+        hostBufferSize = int (bufferSize);
+
+        LOGC ("NIDAQmx: host input buffer ", int (bufferSize), " samples per channel (", bufferSize / taskSampleRate, " s)");
+    }
+
+    /* Raw mode: fetch the polynomial the driver would otherwise apply to each channel */
+    if (plan.useRawSamples && numAnalogInputs)
+    {
+        numScalingCoeffs = NIDAQ::DAQmxGetAIDevScalingCoeff (taskHandleAI, STR2CHR (plan.analogChannelNames[0]), NULL, 0);
+        numScalingCoeffs = jlimit (1, MAX_SCALING_COEFFS, int (numScalingCoeffs));
+
+        scalingCoeffs.calloc (numAnalogInputs * numScalingCoeffs, sizeof (NIDAQ::float64));
+
+        for (int i = 0; i < numAnalogInputs; i++)
+        {
+            NIDAQ::uInt32 sampleSize = 16;
+            DAQmxErrChk (NIDAQ::DAQmxGetAIRawSampSize (taskHandleAI, STR2CHR (plan.analogChannelNames[i]), &sampleSize));
+            if (sampleSize > 16)
+                rawSampleSize = 32;
+
+            DAQmxErrChk (NIDAQ::DAQmxGetAIDevScalingCoeff (taskHandleAI,
+                                                           STR2CHR (plan.analogChannelNames[i]),
+                                                           scalingCoeffs + i * numScalingCoeffs,
+                                                           numScalingCoeffs));
+        }
+
+        LOGD ("Raw acquisition: ", rawSampleSize, "-bit samples, ", numScalingCoeffs, " scaling coefficients per channel");
+    }
+
+    /* Scaled volts always go through the vector kernels; raw counts only when they fit */
+    useConverterForRaw = false;
+
+    if (numAnalogInputs && ! plan.useRawSamples)
+    {
+        converter.prepare (numAnalogInputs, plan.analogEnableMasks.getRawDataPointer());
+    }
+    else if (numAnalogInputs && rawSampleSize == 16 && numScalingCoeffs <= SampleConverter::maxCoeffs)
+    {
+        HeapBlock<float> coeffs (numAnalogInputs * numScalingCoeffs);
+        for (int i = 0; i < numAnalogInputs * numScalingCoeffs; i++)
+            coeffs[i] = float (scalingCoeffs[i]);
+
+        converter.prepare (numAnalogInputs, plan.analogEnableMasks.getRawDataPointer(), coeffs, numScalingCoeffs);
+        useConverterForRaw = true;
+    }
+
+    LOGD ("Sample conversion: ", getSIMDLevelName (converter.getSIMDLevel()));
+
+    for (auto& taskHandleDI : taskHandlesDI)
+        DAQmxErrChk (NIDAQ::DAQmxTaskControl (taskHandleDI, DAQmx_Val_Task_Commit));
+
+    return true;
+
+Error:
+
+    if (DAQmxFailed (error))
+        logDAQmxError();
+
+    releaseTasks();
+
+    return false;
+}
+
+/* Builds one DI task with a channel per enabled port, clocked from the AI sample clock.
+   Returns false (leaving no task behind) if the device cannot time all of the ports. */
+bool NIDAQmx::createMultiPortDITask (const char* trigName)
+{
+    NIDAQ::int32 error = 0;
+    NIDAQ::TaskHandle taskHandleDI = 0;
+
+    /* Create a digital input task using device serial number to gurantee unique task name per device */
+    DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR (String (device->isUSBDevice ? "DITask_USB" : "DITask_PXI") + getSerialNumber()), &taskHandleDI));
+
+    for (int i = 0; i < plan.digitalPortNames.size(); i++)
+        DAQmxErrChk (NIDAQ::DAQmxCreateDIChan (
+            taskHandleDI,
+            STR2CHR (plan.digitalPortNames[i]),
+            "",
+            DAQmx_Val_ChanForAllLines));
+
+    DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (
+        taskHandleDI,
+        trigName, // source : we will sync to analog input clock
+        plan.sampleRate,
+        DAQmx_Val_Rising,
+        plan.singlePoint ? DAQmx_Val_HWTimedSinglePoint : DAQmx_Val_ContSamps,
+        plan.bufferSize));
+
+    if (! plan.singlePoint)
+        DAQmxErrChk (NIDAQ::DAQmxCfgInputBuffer (taskHandleDI, plan.bufferSize));
+
+    /* Catch ports without hardware timing now, rather than when the task starts */
+    DAQmxErrChk (NIDAQ::DAQmxTaskControl (taskHandleDI, DAQmx_Val_Task_Verify));
+
+    portPacker.prepare (plan.digitalPortNames.size(), plan.digitalPortShifts.getRawDataPointer());
+    taskHandlesDI.push_back (taskHandleDI);
+
+    LOGD ("Reading ", plan.digitalPortNames.size(), " digital ports through one task");
+
+    return true;
+
+Error:
+
+    char errBuff[ERR_BUFF_SIZE] = { '\0' };
+    NIDAQ::DAQmxGetExtendedErrorInfo (errBuff, ERR_BUFF_SIZE);
+    LOGC ("NIDAQmx: cannot clock all digital ports together, using one task per port (", errBuff, ")");
+
+    if (taskHandleDI != 0)
+        NIDAQ::DAQmxClearTask (taskHandleDI);
+
+    return false;
+}
+
+/* Switches an AI task to hardware-timed single-point timing */
+NIDAQ::int32 NIDAQmx::configureSinglePointTiming (NIDAQ::TaskHandle task, NIDAQ::float64 rate)
+{
+    NIDAQ::int32 error = 0;
+
+    DAQmxErrChk (NIDAQ::DAQmxCfgSampClkTiming (
+        task,
+        "",
+        rate,
+        DAQmx_Val_Rising,
+        DAQmx_Val_HWTimedSinglePoint,
+        1)); // sampsPerChanToAcquire : ignored for single-point timing
+
+    /* A late wake-up is counted rather than stopping the run */
+    DAQmxErrChk (NIDAQ::DAQmxSetRealTimeConvLateErrorsToWarnings (task, 1));
+
+Error:
+
+    return error;
+}
+
+/* Verifies single-point timing on a throwaway task with the plan's analog inputs. Returns false
+   if the device rejects it (USB devices, for one), so the plan falls back to small continuous reads. */
+bool NIDAQmx::probeSinglePointTiming (const AcquisitionPlan& newPlan)
+{
+    NIDAQ::int32 error = 0;
+    NIDAQ::TaskHandle singlePointQuery = 0;
+
+    DAQmxErrChk (NIDAQ::DAQmxCreateTask (STR2CHR ("SinglePointQuery" + getSerialNumber()), &singlePointQuery));
+
+    for (int i = 0; i < newPlan.numAnalogInputs; i++)
+        DAQmxErrChk (NIDAQ::DAQmxCreateAIVoltageChan (
+            singlePointQuery,
+            STR2CHR (newPlan.analogChannelNames[i]),
+            "",
+            newPlan.terminalConfigs[i],
+            newPlan.voltageRange.min,
+            newPlan.voltageRange.max,
+            DAQmx_Val_Volts,
+            NULL));
+
+    DAQmxErrChk (configureSinglePointTiming (singlePointQuery, newPlan.sampleRate));
+    DAQmxErrChk (NIDAQ::DAQmxTaskControl (singlePointQuery, DAQmx_Val_Task_Verify));
+
+    LOGC ("NIDAQmx: low-latency mode, hardware-timed single-point reads at ", newPlan.sampleRate, " S/s");
+
+Error:
+
+    if (DAQmxFailed (error))
+    {
+        char errBuff[ERR_BUFF_SIZE] = { '\0' };
+        NIDAQ::DAQmxGetExtendedErrorInfo (errBuff, ERR_BUFF_SIZE);
+        LOGC ("NIDAQmx: no single-point timing, low-latency mode reads ", newPlan.samplesPerRead, "-sample blocks (", errBuff, ")");
+    }
+
+    if (singlePointQuery != 0)
+        NIDAQ::DAQmxClearTask (singlePointQuery);
+
+    return ! DAQmxFailed (error);
+}
+
+/* Resets the run state, then starts the tasks */
+bool NIDAQmx::startTasks()
+{
+    /* Ready before the first callback can arrive */
+    prepareFilterBank();
+
+    ai_timestamp = 0;
+    eventCode = 0;
+    lastDigitalWord = 0;
+    decimatedSampleCount = 0;
+
+    for (int line = 0; line < MAX_DIGITAL_LINES; line++)
+    {
+        risingEdgeCounts[line] = 0;
+        fallingEdgeCounts[line] = 0;
+    }
+
+    clockFit.reset (1.0 / taskSampleRate);
+    clockDriftPpm = 0;
+    timestampJitter = 0;
+
+    if (plan.writeClockAnchors)
+        openAnchorFile();
+
+    prepareTrace();
+
+    readDurations.reset();
+    processDurations.reset();
+    readIntervalErrors.reset();
+
+    readerCpuSeconds = 0;
+    processingCpuSeconds = 0;
+
+    lastReadTicks = 0;
+    jitterSum = 0;
+    jitterCount = 0;
+    meanReadJitter = 0;
+    maxReadJitter = 0;
+
+    lateSamples = 0;
+    latencySum = 0;
+    latencyCount = 0;
+    meanPublishLatency = 0;
+    maxPublishLatency = 0;
+
+    stats.reset();
+    numGaps = 0;
+    lostSamples = 0;
+    pendingGap = 0;
+    lastGoodReadTime = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks());
+
+    return startTaskHandles();
+}
+
+/* Starts the configured tasks, at the start of a run and again after each restart */
+bool NIDAQmx::startTaskHandles()
+{
+    NIDAQ::int32 error = 0;
+
+    for (auto& taskHandleDI : taskHandlesDI)
+        DAQmxErrChk (NIDAQ::DAQmxStartTask (taskHandleDI));
+
+    if (plan.numAnalogInputs)
+        DAQmxErrChk (NIDAQ::DAQmxStartTask (taskHandleAI));
+
+    samplesReadThisTask = 0;
+
+    return true;
+
+Error:
+
+    if (DAQmxFailed (error))
+        logDAQmxError();
+
+    return false;
+}
+
+/* Designed when the tasks start rather than with the plan, because committing the task can still coerce the sample rate */
+void NIDAQmx::prepareFilterBank()
+{
+    BiquadBank::Section sections[BiquadBank::maxSections];
+    int numSections = 0;
+
+    const double nyquist = 0.5 * plan.sampleRate;
+
+    if (plan.highPassCutoff > 0 && plan.highPassCutoff < nyquist)
+        sections[numSections++] = BiquadBank::highPass (plan.highPassCutoff, plan.sampleRate);
+
+    if (plan.notchFrequency > 0 && plan.notchFrequency < nyquist)
+        sections[numSections++] = BiquadBank::notch (plan.notchFrequency, plan.sampleRate, NOTCH_Q);
+
+    if (plan.highPassCutoff >= nyquist || plan.notchFrequency >= nyquist)
+        LOGC ("NIDAQmx: filter frequencies at or above ", nyquist, " Hz are ignored at this sample rate");
+
+    filterBank.prepare (plan.numAnalogInputs, sections, numSections);
+
+    if (numSections)
+        LOGD ("Filtering ", plan.numAnalogInputs, " analog inputs with ", numSections, " biquad sections (", getSIMDLevelName (filterBank.getSIMDLevel()), ")");
+}
+
+/* Called from inside the reader and processing threads, once the plan is built */
+void NIDAQmx::applyThreadScheduling (Thread* thread, int core)
+{
+    const String name = thread->getThreadName();
+    String reason;
+
+    if (core >= 0)
+    {
+        if (setCurrentThreadCore (core, reason))
+            LOGC (name, ": pinned to CPU ", core);
+        else
+            LOGC (name, ": could not pin to CPU ", core, ", running unpinned (", reason, ")");
+    }
+
+    if (plan.threadPriority == PRIORITY_REALTIME_RR || plan.threadPriority == PRIORITY_REALTIME_FIFO)
+    {
+        if (setCurrentThreadRealtime (plan.threadPriority, reason))
+        {
+            LOGC (name, ": running with real-time priority (", plan.threadPriority == PRIORITY_REALTIME_FIFO ? "FIFO" : "RR", ")");
+            return;
+        }
+
+        LOGC (name, ": real-time priority refused (", reason, "), falling back to high priority");
+    }
+
+    if (plan.threadPriority != PRIORITY_NORMAL && ! thread->setPriority (Thread::Priority::highest))
+        LOGC (name, ": could not raise thread priority, running at normal priority");
+}
+
+/* Compares the time since the previous read with the duration of the data just read */
+void NIDAQmx::recordReadTime (int numSamples)
+{
+    const int64 now = Time::getHighResolutionTicks();
+
+    if (lastReadTicks != 0 && numSamples > 0)
+    {
+        const double interval = Time::highResolutionTicksToSeconds (now - lastReadTicks);
+        const double jitter = fabs (interval - numSamples / taskSampleRate) * 1e6;
+
+        readIntervalErrors.record (int64 (jitter * 1e3));
+
+        jitterSum += jitter;
+        jitterCount++;
+
+        meanReadJitter = roundToInt (jitterSum / jitterCount);
+
+        if (jitter > maxReadJitter.get())
+            maxReadJitter = roundToInt (jitter);
+    }
+
+    lastReadTicks = now;
+}
+
+void NIDAQmx::recordPublishLatency (double oldestSampleTime)
+{
+    const double latency = (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks()) - oldestSampleTime) * 1e6;
+
+    latencySum += latency;
+    latencyCount++;
+
+    meanPublishLatency = roundToInt (latencySum / latencyCount);
+
+    if (latency > maxPublishLatency.get())
+        maxPublishLatency = roundToInt (latency);
+}
+
+/* Samples waiting in the host buffer, sampled before each read */
+void NIDAQmx::updateBufferOccupancy()
+{
+    NIDAQ::uInt32 available = 0;
+
+    if (! plan.numAnalogInputs || plan.singlePoint || DAQmxFailed (NIDAQ::DAQmxGetReadAvailSampPerChan (taskHandleAI, &available)))
+        return;
+
+    bufferOccupancy = int (available);
+
+    if (int (available) > peakBufferOccupancy.get())
+        peakBufferOccupancy = int (available);
+
+    if (int (available) > recentBufferPeak.get())
+        recentBufferPeak = int (available);
+}
+
+/* Samples the GUI has yet to take from the DataBuffer, sampled after each write */
+void NIDAQmx::updateDataBufferFill()
+{
+    const int fill = aiBuffer->getNumSamples();
+
+    dataBufferFill = fill;
+
+    if (fill > peakDataBufferFill.get())
+        peakDataBufferFill = fill;
+
+    if (fill > recentDataBufferPeak.get())
+        recentDataBufferPeak = fill;
+}
+
+/* Reads the target block size, or as much of a backlog as fits when adaptive reads are enabled */
+int NIDAQmx::getNextReadSize()
+{
+    if (plan.maxSamplesPerRead == plan.samplesPerRead)
+        return plan.samplesPerRead;
+
+    return jlimit (plan.samplesPerRead, plan.maxSamplesPerRead, bufferOccupancy.get());
+}
+
+NIDAQ::int32 NIDAQmx::readBlock (RawBlock& block, int numSampsPerChan, NIDAQ::float64 timeout)
+{
+    NIDAQ::int32 error = 0;
+    NIDAQ::int32 ai_read = 0;
+    NIDAQ::int32 di_read = 0;
+
+    NIDAQ::float64* ai_data = block.ai_data;
+    NIDAQ::int32* ai_raw = block.ai_raw;
+    NIDAQ::uInt32* eventCodes = block.eventCodes;
+
+    const int numAnalogInputs = plan.numAnalogInputs;
+    const uint32 linesEnabled = plan.digitalLineMask;
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    block.numSamples = 0;
+
+    NIDAQ_TRACE_SCOPE (readerTrace, "analog read");
+
+    if (numAnalogInputs && ! plan.useRawSamples)
+        DAQmxErrChk (NIDAQ::DAQmxReadAnalogF64 (
+            taskHandleAI,
+            numSampsPerChan,
+            timeout,
+            DAQmx_Val_GroupByScanNumber, // DAQmx_Val_GroupByScanNumber
+            ai_data,
+            plan.analogReadSize,
+            &ai_read,
+            NULL));
+    else if (numAnalogInputs && rawSampleSize == 16)
+        DAQmxErrChk (NIDAQ::DAQmxReadBinaryI16 (
+            taskHandleAI,
+            numSampsPerChan,
+            timeout,
+            DAQmx_Val_GroupByScanNumber,
+            (NIDAQ::int16*) ai_raw,
+            plan.analogReadSize,
+            &ai_read,
+            NULL));
+    else if (numAnalogInputs)
+        DAQmxErrChk (NIDAQ::DAQmxReadBinaryI32 (
+            taskHandleAI,
+            numSampsPerChan,
+            timeout,
+            DAQmx_Val_GroupByScanNumber,
+            ai_raw,
+            plan.analogReadSize,
+            &ai_read,
+            NULL));
+
+    NIDAQ_TRACE_NEXT ("digital read");
+
+    if (linesEnabled > 0 && multiPortDI)
+    {
+        /* One word per port per scan, merged into the event word at each port's offset */
+        DAQmxErrChk (NIDAQ::DAQmxReadDigitalU32 (
+            taskHandlesDI[0],
+            numSampsPerChan,
+            timeout,
+            DAQmx_Val_GroupByScanNumber,
+            di_data,
+            numSampsPerChan * plan.digitalPortNames.size(),
+            &di_read,
+            NULL));
+
+        portPacker.pack (di_data, eventCodes, di_read);
+        holdDigitalWord (eventCodes, di_read, ai_read);
+    }
+    else if (linesEnabled > 0)
+    {
+        /* Ports can return different counts; only scans every port returned are kept */
+        int minRead = numSampsPerChan;
+
+        for (int i = 0; i < numSampsPerChan; i++)
+            eventCodes[i] = 0;
+
+        for (int t = 0; t < taskHandlesDI.size(); t++)
+        {
+            NIDAQ_TRACE_SCOPE (readerTrace, "port read");
+
+            NIDAQ::TaskHandle taskHandleDI = taskHandlesDI[t];
+            const int shift = plan.digitalPortShifts[t];
+
+            if (plan.digitalReadSize == 32)
+            {
+                NIDAQ::uInt32* di_data_32_ = di_data;
+                DAQmxErrChk (NIDAQ::DAQmxReadDigitalU32 (
+                    taskHandleDI,
+                    numSampsPerChan,
+                    timeout,
+                    DAQmx_Val_GroupByScanNumber,
+                    di_data_32_,
+                    numSampsPerChan,
+                    &di_read,
+                    NULL));
+                for (int i = 0; i < di_read; i++)
+                    eventCodes[i] |= (di_data_32_[i] << shift);
+            }
+            else if (plan.digitalReadSize == 16)
+            {
+                NIDAQ::uInt16* di_data_16_ = (NIDAQ::uInt16*) di_data.getData();
+                DAQmxErrChk (NIDAQ::DAQmxReadDigitalU16 (
+                    taskHandleDI,
+                    numSampsPerChan,
+                    timeout,
+                    DAQmx_Val_GroupByScanNumber,
+                    di_data_16_,
+                    numSampsPerChan,
+                    &di_read,
+                    NULL));
+                for (int i = 0; i < di_read; i++)
+                    eventCodes[i] |= (di_data_16_[i] << shift);
+            }
+            else if (plan.digitalReadSize == 8)
+            {
+                NIDAQ::uInt8* di_data_8_ = (NIDAQ::uInt8*) di_data.getData();
+                DAQmxErrChk (NIDAQ::DAQmxReadDigitalU8 (
+                    taskHandleDI,
+                    numSampsPerChan,
+                    timeout,
+                    DAQmx_Val_GroupByScanNumber,
+                    di_data_8_,
+                    numSampsPerChan,
+                    &di_read,
+                    NULL));
+                for (int i = 0; i < di_read; i++)
+                    eventCodes[i] |= (di_data_8_[i] << shift);
+            }
+
+            minRead = jmin (minRead, int (di_read));
+        }
+
+        holdDigitalWord (eventCodes, minRead, ai_read);
+    }
+
+    block.numSamples = ai_read;
+    block.readTime = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks());
+
+    const int64 readTicks = Time::getHighResolutionTicks() - startTicks;
+
+    stats.recordRead (ai_read, int64 (ai_read) * getBytesPerScan(), readTicks);
+    readDurations.record (int64 (Time::highResolutionTicksToSeconds (readTicks) * 1e9));
+
+Error:
+
+    return error;
+}
+
+/* DAQmx can return fewer digital scans than analog ones; the rest of the block holds the last
+   word read instead of whatever an earlier block left there, so it adds no spurious edges */
+void NIDAQmx::holdDigitalWord (NIDAQ::uInt32* eventCodes, int numRead, int numScans)
+{
+    const int numHeld = jmin (numRead, numScans);
+
+    if (numHeld > 0)
+        lastDigitalWord = eventCodes[numHeld - 1];
+
+    for (int i = numRead; i < numScans; i++)
+        eventCodes[i] = lastDigitalWord;
+}
+
+/* Tallies the edges in one block from its transitions: the XOR with the previous word flags
+   the lines that changed, and only those bits are visited. Counters are published once per block. */
+void NIDAQmx::countDigitalEdges (int numTransitions)
+{
+    uint32 rising[MAX_DIGITAL_LINES] = { 0 };
+    uint32 falling[MAX_DIGITAL_LINES] = { 0 };
+    uint32 linesChanged = 0;
+
+    uint32 previous = uint32 (eventCode);
+
+    for (int t = 0; t < numTransitions; t++)
+    {
+        const uint32 code = transitionWords[t];
+        const uint32 changed = code ^ previous;
+
+        for (uint32 bits = changed; bits != 0; bits &= bits - 1)
+        {
+            const int line = findLowestSetBit (bits);
+
+            if (code & (1u << line))
+                rising[line]++;
+            else
+                falling[line]++;
+        }
+
+        linesChanged |= changed;
+        previous = code;
+    }
+
+    for (uint32 bits = linesChanged; bits != 0; bits &= bits - 1)
+    {
+        const int line = findLowestSetBit (bits);
+
+        risingEdgeCounts[line] += rising[line];
+        fallingEdgeCounts[line] += falling[line];
+    }
+}
+
+void AcquisitionStats::reset()
+{
+    for (auto* counter : { &reads, &samples, &bytes, &readTicks, &conversionTicks, &publishTicks, &maxLoopTicks, &overflows, &restarts })
+        counter->store (0, std::memory_order_relaxed);
+}
+
+void AcquisitionStats::recordRead (int64 numSamples, int64 numBytes, int64 ticks)
+{
+    add (reads, 1);
+    add (samples, numSamples);
+    add (bytes, numBytes);
+    add (readTicks, ticks);
+}
+
+void AcquisitionStats::recordLoop (int64 ticks)
+{
+    if (ticks > get (maxLoopTicks))
+        maxLoopTicks.store (ticks, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& count : counts)
+        count.store (0, std::memory_order_relaxed);
+
+    maxValue.store (0, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Summary LatencyHistogram::getSummary() const
+{
+    Summary summary;
+    summary.max = maxValue.load (std::memory_order_relaxed);
+
+    /* Counts taken once, so the percentiles agree with each other while the writer runs */
+    HeapBlock<int64> snapshot (numBuckets);
+
+    for (int i = 0; i < numBuckets; i++)
+    {
+        snapshot[i] = counts[i].load (std::memory_order_relaxed);
+        summary.count += snapshot[i];
+    }
+
+    if (summary.count == 0)
+        return summary;
+
+    const double fractions[] = { 0.5, 0.99, 0.999 };
+    int64* results[] = { &summary.p50, &summary.p99, &summary.p999 };
+
+    int64 cumulative = 0;
+    int bucket = 0;
+
+    for (int p = 0; p < 3; p++)
+    {
+        const int64 rank = jmax ((int64) 1, int64 (ceil (fractions[p] * summary.count)));
+
+        while (cumulative + snapshot[bucket] < rank && bucket < numBuckets - 1)
+            cumulative += snapshot[bucket++];
+
+        const int64 upper = bucket < numBuckets - 1 ? getBucketStart (bucket + 1) - 1 : summary.max;
+        *results[p] = jmin (upper, summary.max);
+    }
+
+    return summary;
+}
+
+void LatencyHistogram::writeCsv (OutputStream& stream, const String& name) const
+{
+    for (int i = 0; i < numBuckets; i++)
+    {
+        const int64 count = counts[i].load (std::memory_order_relaxed);
+
+        if (count > 0)
+            stream << name << "," << String (getBucketStart (i)) << "," << String (getBucketStart (i + 1) - 1) << "," << String (count) << "\n";
+    }
+}
+
+/* Rings are allocated here, before any thread records into them; the processing thread gets its
+   own only when blocks are handed over to it, otherwise everything runs on the reader */
+void NIDAQmx::prepareTrace()
+{
+    readerTrace = nullptr;
+    processTrace = nullptr;
+
+    if (! plan.traceAcquisition || ! NIDAQ_TRACING)
+        return;
+
+    readerRing.prepare (plan.useCallbacks ? "DAQmx callback" : "Reader", 1, TRACE_RING_EVENTS);
+    readerTrace = &readerRing;
+
+    if (plan.useCallbacks || plan.singlePoint)
+    {
+        processTrace = readerTrace;
+    }
+    else
+    {
+        processingRing.prepare ("Processing", 2, TRACE_RING_EVENTS);
+        processTrace = &processingRing;
+    }
+
+    traceOriginTicks = Time::getHighResolutionTicks();
+}
+
+void NIDAQmx::writeTrace()
+{
+    Array<const TraceRing*> rings;
+    rings.add (readerTrace);
+
+    if (processTrace != readerTrace)
+        rings.add (processTrace);
+
+    readerTrace = nullptr;
+    processTrace = nullptr;
+
+    File file = CoreServices::getRecordingParentDirectory().getChildFile (
+        device->getName() + "_trace_" + Time::getCurrentTime().formatted ("%Y-%m-%d_%H-%M-%S") + ".json");
+
+    if (! writeChromeTrace (file, rings, traceOriginTicks))
+    {
+        LOGE ("NIDAQmx: could not write trace file ", file.getFullPathName());
+        return;
+    }
+
+    uint64 dropped = 0;
+
+    for (auto* ring : rings)
+        dropped += ring->getNumDropped();
+
+    LOGC ("NIDAQmx: wrote acquisition trace to ", file.getFullPathName(), dropped > 0 ? " (oldest " + String (int64 (dropped)) + " phases overwritten)" : "");
+}
+
+static void logHistogram (const char* name, const LatencyHistogram& histogram)
+{
+    const LatencyHistogram::Summary summary = histogram.getSummary();
+
+    LOGC ("NIDAQmx: ", name, " p50 ", summary.p50 / 1000.0, " us, p99 ", summary.p99 / 1000.0,
+          " us, p99.9 ", summary.p999 / 1000.0, " us, max ", summary.max / 1000.0, " us");
+}
+
+void NIDAQmx::writeHistograms()
+{
+    File file = CoreServices::getRecordingParentDirectory().getChildFile (
+        device->getName() + "_latency_" + Time::getCurrentTime().formatted ("%Y-%m-%d_%H-%M-%S") + ".csv");
+
+    file.deleteFile();
+
+    FileOutputStream stream (file);
+
+    if (stream.failedToOpen())
+    {
+        LOGE ("NIDAQmx: could not open latency histogram file ", file.getFullPathName());
+        return;
+    }
+
+    /* Bucket bounds are inclusive, in nanoseconds */
+    stream << "histogram,low_ns,high_ns,count\n";
+
+    readDurations.writeCsv (stream, "read_duration");
+    processDurations.writeCsv (stream, "process_duration");
+    readIntervalErrors.writeCsv (stream, "read_interval_error");
+
+    LOGC ("NIDAQmx: wrote latency histograms to ", file.getFullPathName());
+}
+
+void NIDAQmx::openAnchorFile()
+{
+    File file = CoreServices::getRecordingParentDirectory().getChildFile (
+        device->getName() + "_clock_anchors_" + Time::getCurrentTime().formatted ("%Y-%m-%d_%H-%M-%S") + ".bin");
+
+    anchorStream = new FileOutputStream (file);
+
+    if (anchorStream->failedToOpen())
+    {
+        LOGE ("NIDAQmx: could not open clock anchor file ", file.getFullPathName());
+        anchorStream = nullptr;
+        return;
+    }
+
+    /* "NIDQANC1" and the nominal sample rate, then little-endian (int64 sample index, float64 host seconds) pairs */
+    anchorStream->write ("NIDQANC1", 8);
+    anchorStream->writeDouble (plan.sampleRate);
+
+    LOGC ("NIDAQmx: writing clock anchors to ", file.getFullPathName());
+}
+
+void NIDAQmx::processBlock (const RawBlock& block)
+{
+    const NIDAQ::int32 ai_read = block.numSamples;
+    const NIDAQ::float64* ai_data = block.ai_data;
+    const NIDAQ::int32* ai_raw = block.ai_raw;
+    const NIDAQ::uInt32* eventCodes = block.eventCodes;
+
+    const int numAnalogInputs = plan.numAnalogInputs;
+    const uint32 linesEnabled = plan.digitalLineMask;
+    const int* enabledChannels = plan.enabledAnalogChannels.getRawDataPointer();
+    const int numEnabledChannels = plan.enabledAnalogChannels.size();
+    const int64 startTicks = Time::getHighResolutionTicks();
+
+    /* Samples lost to a task restart: their numbers are skipped, so later samples keep their true index */
+    if (block.gapBefore > 0)
+        recordGap (block.gapBefore);
+
+    NIDAQ_TRACE_SCOPE (processTrace, "convert");
+
+    /* Convert the interleaved read into a float block (one scan per row, as the DataBuffer expects) */
+    if (numAnalogInputs && ! plan.useRawSamples)
+    {
+        converter.convert (ai_data, aiBlock, ai_read);
+    }
+    else if (useConverterForRaw)
+    {
+        converter.convert ((const int16_t*) ai_raw, aiBlock, ai_read);
+    }
+    else if (numAnalogInputs)
     {
-        for (auto& taskHandleDI : taskHandlesDI)
-            DAQmxErrChk (NIDAQ::DAQmxStartTask (taskHandleDI));
+        for (int i = 0; i < ai_read; i++)
+        {
+            float* samples = aiBlock + i * numAnalogInputs;
+
+            if (rawSampleSize == 16)
+            {
+                const NIDAQ::int16* scan = (const NIDAQ::int16*) ai_raw + i * numAnalogInputs;
+                scaleRawScan (scan, samples, enabledChannels, numEnabledChannels, scalingCoeffs, numScalingCoeffs);
+            }
+            else
+            {
+                const NIDAQ::int32* scan = ai_raw + i * numAnalogInputs;
+                scaleRawScan (scan, samples, enabledChannels, numEnabledChannels, scalingCoeffs, numScalingCoeffs);
+            }
+        }
     }
-    if (numActiveAnalogInputs)
-        DAQmxErrChk (NIDAQ::DAQmxStartTask (taskHandleAI));
 
-    NIDAQ::int32 numSampsPerChan = CHANNEL_BUFFER_SIZE;
-    if (device->isUSBDevice)
-        numSampsPerChan = 100;
+    NIDAQ_TRACE_NEXT ("filter");
 
-    NIDAQ::int32 arraySizeInSamps = numActiveAnalogInputs * numSampsPerChan;
-    NIDAQ::float64 timeout = 5.0;
+    /* Conditioned in place, so the data is published (and decimated) already filtered */
+    if (numAnalogInputs)
+        filterBank.process (aiBlock, ai_read);
 
-    uint64 linesEnabled = 0;
-    double ts;
+    NIDAQ_TRACE_NEXT ("timestamps");
 
-    ai_timestamp = 0;
-    eventCode = 0;
+    for (int i = 0; i < ai_read; i++)
+        sampleNumbers[i] = ai_timestamp + i;
 
-    while (! threadShouldExit())
+    /* Each read returns just after its last sample was acquired, which anchors the fit */
+    if (ai_read > 0)
     {
-        if (numActiveAnalogInputs)
-            DAQmxErrChk (NIDAQ::DAQmxReadAnalogF64 (
-                taskHandleAI,
-                numSampsPerChan,
-                timeout,
-                DAQmx_Val_GroupByScanNumber, // DAQmx_Val_GroupByScanNumber
-                ai_data,
-                arraySizeInSamps,
-                &ai_read,
-                NULL));
+        const int64 lastSample = ai_timestamp + ai_read - 1;
 
-        if (getActiveDigitalLines() > 0)
-        {
-            for (int i = 0; i < CHANNEL_BUFFER_SIZE; i++)
-                eventCodes[i] = 0;
+        clockFit.addAnchor (lastSample, block.readTime);
+        rampFiller.fill (timestamps, ai_read, clockFit.getHostTime (ai_timestamp), clockFit.getSamplePeriod());
 
-            int portIdx = 0;
-            for (auto& taskHandleDI : taskHandlesDI)
-            {
-                if (digitalReadSize == 32)
-                {
-                    NIDAQ::uInt32 di_data_32_[CHANNEL_BUFFER_SIZE];
-                    DAQmxErrChk (NIDAQ::DAQmxReadDigitalU32 (
-                        taskHandleDI,
-                        numSampsPerChan,
-                        timeout,
-                        DAQmx_Val_GroupByScanNumber,
-                        di_data_32_,
-                        numSampsPerChan,
-                        &di_read,
-                        NULL));
-                    for (int i = 0; i < numSampsPerChan; i++)
-                        eventCodes[i] |= (di_data_32_[i] << PORT_SIZE * portIdx);
-                }
-                else if (digitalReadSize == 16)
-                {
-                    NIDAQ::uInt16 di_data_16_[CHANNEL_BUFFER_SIZE];
-                    DAQmxErrChk (NIDAQ::DAQmxReadDigitalU16 (
-                        taskHandleDI,
-                        numSampsPerChan,
-                        timeout,
-                        DAQmx_Val_GroupByScanNumber,
-                        di_data_16_,
-                        numSampsPerChan,
-                        &di_read,
-                        NULL));
-                    for (int i = 0; i < numSampsPerChan; i++)
-                        eventCodes[i] |= (di_data_16_[i] << PORT_SIZE * portIdx);
-                }
-                else if (digitalReadSize == 8)
-                {
-                    NIDAQ::uInt8 di_data_8_[CHANNEL_BUFFER_SIZE];
-                    DAQmxErrChk (NIDAQ::DAQmxReadDigitalU8 (
-                        taskHandleDI,
-                        numSampsPerChan,
-                        timeout,
-                        DAQmx_Val_GroupByScanNumber,
-                        di_data_8_,
-                        numSampsPerChan,
-                        &di_read,
-                        NULL));
-                    for (int i = 0; i < numSampsPerChan; i++)
-                        eventCodes[i] |= (di_data_8_[i] << PORT_SIZE * portIdx);
-                }
-
-                portIdx++;
-            }
-        }
+        clockDriftPpm = clockFit.getDriftPpm();
+        timestampJitter = clockFit.getResidualRms() * 1e6;
 
-        /*
-		std::chrono::milliseconds last_time;
-		std::chrono::milliseconds t = std::chrono::duration_cast< std::chrono::milliseconds >(
-			std::chrono::system_clock::now().time_since_epoch());
-		long long t_ms = t.count()*std::chrono::milliseconds::period::num / std::chrono::milliseconds::period::den;
-		if (ai_read>0) {
-			printf("Read @ %i | ", t_ms);
-			printf("Acquired %d AI samples. Total %d | ", (int)ai_read, (int)(totalAIRead += ai_read));
-			printf("Acquired %d DI samples. Total %d\n", (int)di_read, (int)(totalDIRead += di_read));
-			fflush(stdout);
-		}
-		*/
-
-        float aiSamples[MAX_NUM_AI_CHANNELS];
-        int count = 0;
-        for (int i = 0; i < arraySizeInSamps; i++)
+        if (anchorStream != nullptr)
         {
-            int channel = i % numActiveAnalogInputs;
+            anchorStream->writeInt64 (lastSample);
+            anchorStream->writeDouble (block.readTime);
+        }
+    }
 
-            aiSamples[channel] = ai[channel]->isEnabled() ? ai_data[i] : 0;
+    NIDAQ_TRACE_NEXT ("events");
 
-            if (i % numActiveAnalogInputs == 0)
-            {
-                ai_timestamp++;
-                if (getActiveDigitalLines() > 0)
-                {
-                    eventCode = eventCodes[count++] & getActiveDigitalLines();
-
-                    if (! digitalLineMap.count (eventCode))
-                    {
-                        digitalLineMap[eventCode] = 1;
-                    }
-                }
-                aiBuffer->addToBuffer (aiSamples, &ai_timestamp, &ts, &eventCode, 1);
-            }
-        }
+    /* The event word only needs work where it changes; between transitions it is a plain fill */
+    int numTransitions = 0;
+
+    if (linesEnabled > 0)
+    {
+        numTransitions = transitionDetector.detect (eventCodes, ai_read, linesEnabled, uint32 (eventCode), transitionIndices, transitionWords);
+        countDigitalEdges (numTransitions);
+    }
+
+    int segmentStart = 0;
+
+    for (int t = 0; t < numTransitions; t++)
+    {
+        std::fill (eventCodeBlock + segmentStart, eventCodeBlock + transitionIndices[t], eventCode);
+
+        eventCode = transitionWords[t];
+        segmentStart = transitionIndices[t];
+    }
+
+    std::fill (eventCodeBlock + segmentStart, eventCodeBlock + ai_read, eventCode);
+
+    NIDAQ_TRACE_NEXT ("addToBuffer");
+
+    const int64 publishTicks = Time::getHighResolutionTicks();
+
+    if (ai_read > 0)
+    {
+        aiBuffer->addToBuffer (aiBlock, sampleNumbers, timestamps, eventCodeBlock, ai_read);
+        recordPublishLatency (timestamps[0]);
+        updateDataBufferFill();
+    }
+
+    const int64 publishedTicks = Time::getHighResolutionTicks();
+
+    NIDAQ_TRACE_NEXT ("decimate");
+
+    if (plan.decimationFactor > 1 && decimatedBuffer != nullptr)
+        processDecimatedBlock (ai_read);
+
+    /* Decimation counts as conversion: it is filtering, the write at its end is small */
+    const int64 endTicks = Time::getHighResolutionTicks();
+
+    stats.recordPublish (publishedTicks - publishTicks);
+    stats.recordConversion ((publishTicks - startTicks) + (endTicks - publishedTicks));
+    processDurations.record (int64 (Time::highResolutionTicksToSeconds (endTicks - startTicks) * 1e9));
+
+    ai_timestamp += ai_read;
+
+    lastReadSize = ai_read;
+}
+
+/* Bytes the driver hands back per scan: every analog input at the read's sample size, plus the digital words */
+int NIDAQmx::getBytesPerScan() const
+{
+    int bytes = plan.numAnalogInputs * (plan.useRawSamples ? rawSampleSize / 8 : int (sizeof (NIDAQ::float64)));
+
+    if (plan.digitalLineMask > 0 && multiPortDI)
+        bytes += plan.digitalPortNames.size() * int (sizeof (NIDAQ::uInt32));
+    else if (plan.digitalLineMask > 0)
+        bytes += taskHandlesDI.size() * plan.digitalReadSize / 8;
+
+    return bytes;
+}
+
+void NIDAQmx::recordGap (int64 numSamples)
+{
+    LOGC ("NIDAQmx: gap of ", numSamples, " samples (", numSamples * 1000.0 / plan.sampleRate, " ms) starting at sample ", ai_timestamp);
+
+    ai_timestamp += numSamples;
+
+    if (plan.decimationFactor > 1 && decimatedBuffer != nullptr)
+    {
+        /* Skip the outputs that fell due within the gap, then restart the filter with an empty
+           history so that no output mixes samples from both sides of it */
+        const int phase = decimator.getPhase();
+
+        if (numSamples > phase)
+            decimatedSampleCount += (numSamples - 1 - phase) / plan.decimationFactor + 1;
+
+        decimator.prepare (plan.numAnalogInputs, plan.decimationFactor, plan.decimationTaps, plan.maxSamplesPerRead);
+    }
+
+    numGaps += 1;
+    lostSamples += numSamples;
+}
+
+/* Runs after the full-rate block is complete (aiBlock, eventCodeBlock and the clock fit),
+   before ai_timestamp moves past it */
+void NIDAQmx::processDecimatedBlock (int numSamples)
+{
+    const int count = decimator.process (aiBlock, numSamples, decimatedBlock, decimatedIndices);
+
+    if (count == 0)
+        return;
+
+    for (int i = 0; i < count; i++)
+    {
+        decimatedSampleNumbers[i] = decimatedSampleCount + i;
+        decimatedEventCodes[i] = eventCodeBlock[decimatedIndices[i]];
+    }
+
+    /* Each output is centred on the middle of the filter, a group delay behind its newest input */
+    const double period = clockFit.getSamplePeriod();
+    const double first = clockFit.getHostTime (ai_timestamp + decimatedIndices[0]) - decimator.getGroupDelay() * period;
+
+    rampFiller.fill (decimatedTimestamps, count, first, period * plan.decimationFactor);
+
+    decimatedBuffer->addToBuffer (decimatedBlock, decimatedSampleNumbers, decimatedTimestamps, decimatedEventCodes, count);
+
+    decimatedSampleCount += count;
+}
+
+void NIDAQmx::clearTasks()
+{
+    if (taskHandleAI != 0 && hostBufferSize.get() > 0)
+        LOGC ("NIDAQmx: peak host buffer occupancy ", peakBufferOccupancy.get(), " of ", hostBufferSize.get(), " samples per channel (", 100.0 * peakBufferOccupancy.get() / hostBufferSize.get(), "%)");
+
+    releaseTasks();
+
+    if (clockFit.getNumAnchors() > 1)
+        LOGC ("NIDAQmx: sample clock drift ", clockDriftPpm.get(), " ppm against the host clock, timestamp jitter ", timestampJitter.get(), " us RMS");
+
+    if (latencyCount > 0)
+        LOGC ("NIDAQmx: publish latency mean ", meanPublishLatency.get(), " us, max ", maxPublishLatency.get(), " us", plan.singlePoint ? ", " + String (lateSamples.get()) + " late sample clocks" : "");
+
+    if (stats.getRestarts() > 0)
+        LOGC ("NIDAQmx: ", stats.getRestarts(), " task restarts, ", numGaps.get(), " gaps, ", lostSamples.get(), " samples lost");
+
+    if (readerTrace != nullptr)
+        writeTrace();
+
+    if (readDurations.getSummary().count > 0)
+    {
+        logHistogram ("read duration", readDurations);
+        logHistogram ("processing duration", processDurations);
+        logHistogram ("read interval error", readIntervalErrors);
 
-        // fflush(stdout);
+        if (plan.writeLatencyHistograms)
+            writeHistograms();
     }
 
+    anchorStream = nullptr;
+
+    lastReadSize = 0;
+
+    fflush (stdout);
+}
+
+/* Stops and clears the DAQmx tasks only; run statistics and buffers are left alone */
+void NIDAQmx::releaseTasks()
+{
     /*********************************************/
     // DAQmx Stop Code
     /*********************************************/
 
-    if (numActiveAnalogInputs)
+    if (taskHandleAI != 0)
+    {
         NIDAQ::DAQmxStopTask (taskHandleAI);
-    if (numActiveAnalogInputs)
         NIDAQ::DAQmxClearTask (taskHandleAI);
-    if (numActiveDigitalInputs)
+        taskHandleAI = 0;
+    }
+
+    for (auto& taskHandleDI : taskHandlesDI)
+    {
+        NIDAQ::DAQmxStopTask (taskHandleDI);
+        NIDAQ::DAQmxClearTask (taskHandleDI);
+    }
+
+    taskHandlesDI.clear();
+}
+
+bool NIDAQmx::recoverAcquisition (NIDAQ::int32 error)
+{
+    /* Samples the device acquired that were never read, while the task can still be asked */
+    NIDAQ::uInt64 acquired = 0;
+    int64 stranded = 0;
+
+    if (plan.numAnalogInputs && ! DAQmxFailed (NIDAQ::DAQmxGetReadTotalSampPerChanAcquired (taskHandleAI, &acquired)))
+        stranded = jmax ((int64) 0, int64 (acquired) - samplesReadThisTask);
+
+    String reason = "DAQmx error " + String (error);
+
+    if (error == DAQmxErrorSamplesNoLongerAvailable || (hostBufferSize.get() > 0 && stranded > hostBufferSize.get()))
+    {
+        reason = "host buffer overflow (" + String (stranded) + " samples unread)";
+        stats.recordOverflow();
+    }
+    else if (error == DAQmxErrorSamplesNotYetAvailable)
+        reason = "no samples for " + String (plan.readTimeout, 1) + " s (" + String (int64 (acquired)) + " acquired, " + String (samplesReadThisTask) + " read)";
+
+    /* Queued blocks are processed first: the processing thread must be idle before
+       createTasks rebuilds the converter it uses */
+    while (blockFifo.getNumReady() > 0 && ! threadShouldExit())
+        blockFreed.wait (PIPELINE_WAIT_MS);
+
+    releaseTasks();
+
+    for (int attempt = 0; attempt < MAX_RESTART_ATTEMPTS; attempt++)
     {
-        for (auto& taskHandleDI : taskHandlesDI)
+        const int backoffMs = jmin (MAX_RESTART_BACKOFF_MS, RESTART_BACKOFF_MS << attempt);
+
+        LOGC ("NIDAQmx: ", reason, ", restarting the tasks in ", backoffMs, " ms (attempt ", attempt + 1, " of ", MAX_RESTART_ATTEMPTS, ")");
+
+        /* Woken early by stopAcquisition; any other wake-up goes back to waiting */
+        const uint32 restartAt = Time::getMillisecondCounter() + uint32 (backoffMs);
+
+        while (! threadShouldExit() && Time::getMillisecondCounter() < restartAt)
+            wait (int (restartAt - Time::getMillisecondCounter()));
+
+        if (threadShouldExit())
+            return false;
+
+        if (createTasks())
         {
-            NIDAQ::DAQmxStopTask (taskHandleDI);
-            NIDAQ::DAQmxClearTask (taskHandleDI);
+            if (startTaskHandles())
+            {
+                /* The new task's first sample follows the last good read by the time the tasks were down */
+                const double startTime = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks());
+                const int64 elapsed = int64 ((startTime - lastGoodReadTime) * taskSampleRate + 0.5);
+
+                pendingGap = jmax (stranded, elapsed);
+                stats.recordRestart();
+
+                return true;
+            }
+
+            releaseTasks();
         }
     }
 
-    return;
+    LOGE ("NIDAQmx: acquisition stopped, the tasks could not be restarted after ", MAX_RESTART_ATTEMPTS, " attempts");
 
-Error:
+    return false;
+}
 
-    if (DAQmxFailed (error))
-        NIDAQ::DAQmxGetExtendedErrorInfo (errBuff, ERR_BUFF_SIZE);
+void NIDAQmx::run()
+{
+    if (plan.useCallbacks)
+    {
+        superviseCallbacks();
+        return;
+    }
 
-    if (taskHandleAI != 0)
+    applyThreadScheduling (this, plan.cpuCore);
+
+    prepareBlocks();
+
+    if (! createTasks())
+        return;
+
+    if (! startTasks())
     {
-        // DAQmx Stop Code
-        NIDAQ::DAQmxStopTask (taskHandleAI);
-        NIDAQ::DAQmxClearTask (taskHandleAI);
+        clearTasks();
+        return;
+    }
+
+    if (plan.singlePoint)
+    {
+        runSinglePoint();
+        clearTasks();
+        return;
     }
 
-    if (taskHandlesDI.size() > 0)
+    blockFifo.reset();
+    peakQueueDepth = 0;
+    readerStalls = 0;
+    processorWaits = 0;
+
+    processingThread->startThread();
+
+    const double cpuSecondsAtStart = getThreadCpuSeconds();
+
+    /* Reader: only drains DAQmx into free block slots; conversion and publishing happen
+       on the processing thread, so they cannot delay the next driver read */
+    int64 loopStart = Time::getHighResolutionTicks();
+    bool stalled = false;
+
+    while (! threadShouldExit())
     {
-        for (auto& taskHandleDI : taskHandlesDI)
+        NIDAQ_TRACE_SCOPE (readerTrace, "wait for slot");
+
+        int start1, size1, start2, size2;
+        blockFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
         {
-            // DAQmx Stop Code
-            NIDAQ::DAQmxStopTask (taskHandleDI);
-            NIDAQ::DAQmxClearTask (taskHandleDI);
+            /* Counted once per stall, however many waits it takes */
+            if (! stalled)
+                readerStalls += 1;
+
+            stalled = true;
+            blockFreed.wait (PIPELINE_WAIT_MS);
+            continue;
+        }
+
+        stalled = false;
+
+        NIDAQ_TRACE_NEXT ("buffer occupancy");
+
+        updateBufferOccupancy();
+
+        NIDAQ_TRACE_NEXT ("read");
+
+        RawBlock& block = *rawBlocks[start1];
+        const NIDAQ::int32 error = readBlock (block, getNextReadSize(), plan.readTimeout);
+
+        if (DAQmxFailed (error))
+        {
+            NIDAQ_TRACE_NEXT ("restart");
+
+            logDAQmxError();
+
+            if (! recoverAcquisition (error))
+                break;
+
+            continue;
         }
+
+        NIDAQ_TRACE_NEXT ("queue");
+
+        block.gapBefore = pendingGap;
+        pendingGap = 0;
+
+        samplesReadThisTask += block.numSamples;
+        lastGoodReadTime = block.readTime;
+
+        recordReadTime (block.numSamples);
+
+        blockFifo.finishedWrite (1);
+        blockReady.signal();
+
+        const int queueDepth = blockFifo.getNumReady();
+
+        if (queueDepth > peakQueueDepth.get())
+            peakQueueDepth = queueDepth;
+
+        const int64 loopEnd = Time::getHighResolutionTicks();
+        stats.recordLoop (loopEnd - loopStart);
+        loopStart = loopEnd;
+
+        readerCpuSeconds = getThreadCpuSeconds() - cpuSecondsAtStart;
     }
-    if (DAQmxFailed (error))
-        LOGE ("DAQmx Error: ", errBuff);
-    fflush (stdout);
 
-    return;
-}
\ No newline at end of file
+    const double cpuSeconds = getThreadCpuSeconds() - cpuSecondsAtStart;
+
+    /* The processing thread drains whatever is queued before it exits */
+    processingThread->signalThreadShouldExit();
+    blockReady.signal();
+    processingThread->waitForThreadToExit (-1);
+
+    if (ai_timestamp > 0)
+    {
+        double dataSeconds = ai_timestamp / plan.sampleRate;
+
+        LOGC ("NIDAQmx: reader thread used ", cpuSeconds * 1000.0 / dataSeconds, " ms of CPU per second of data (", plan.numAnalogInputs, " AI @ ", plan.sampleRate, " S/s)");
+        LOGC ("NIDAQmx: read jitter mean ", meanReadJitter.get(), " us, max ", maxReadJitter.get(), " us");
+        LOGC ("NIDAQmx: pipeline peak depth ", peakQueueDepth.get(), " of ", PIPELINE_DEPTH - 1, " blocks, ", readerStalls.get(), " reader stalls, ", processorWaits.get(), " processor waits");
+    }
+
+    clearTasks();
+}
+
+/* Callback runs: the tasks are already running and the callbacks only read, so this thread
+   restarts the tasks when a callback fails, or when none has arrived for plan.readTimeout */
+void NIDAQmx::superviseCallbacks()
+{
+    const int watchdogMs = roundToInt (plan.readTimeout * 1000.0);
+    double restartTime = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks());
+
+    while (! threadShouldExit())
+    {
+        wait (watchdogMs);
+
+        if (threadShouldExit())
+            break;
+
+        NIDAQ::int32 error = 0;
+
+        {
+            const ScopedLock lock (callbackLock);
+            const double now = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks());
+
+            if (! callbacksEnabled)
+            {
+                error = callbackError;
+            }
+            else if (now - jmax (lastGoodReadTime, restartTime) > plan.readTimeout)
+            {
+                error = DAQmxErrorSamplesNotYetAvailable;
+                callbacksEnabled = false;
+            }
+
+            callbackError = 0;
+        }
+
+        if (error == 0)
+            continue;
+
+        if (! recoverAcquisition (error))
+            break;
+
+        /* The first callback of the new task needs a full block, so none is missed here */
+        {
+            const ScopedLock lock (callbackLock);
+            callbacksEnabled = true;
+        }
+
+        restartTime = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks());
+    }
+
+    /* Wait for a callback in progress, so none touches the tasks once they are cleared */
+    {
+        const ScopedLock lock (callbackLock);
+        callbacksEnabled = false;
+    }
+
+    clearTasks();
+}
+
+/* One scan per sample clock, processed on this thread as soon as it is read: no block to fill
+   and no hand-off to the processing thread */
+void NIDAQmx::runSinglePoint()
+{
+    RawBlock& block = *rawBlocks[0];
+    const double cpuSecondsAtStart = getThreadCpuSeconds();
+
+    while (! threadShouldExit())
+    {
+        const int64 loopStart = Time::getHighResolutionTicks();
+
+        NIDAQ_TRACE_SCOPE (readerTrace, "wait for clock");
+
+        NIDAQ::bool32 isLate = 0;
+        NIDAQ::int32 error = NIDAQ::DAQmxWaitForNextSampleClock (taskHandleAI, plan.readTimeout, &isLate);
+
+        NIDAQ_TRACE_NEXT ("read");
+
+        if (! DAQmxFailed (error))
+            error = readBlock (block, 1, plan.readTimeout);
+
+        if (DAQmxFailed (error))
+        {
+            NIDAQ_TRACE_NEXT ("restart");
+
+            logDAQmxError();
+
+            if (! recoverAcquisition (error))
+                break;
+
+            continue;
+        }
+
+        if (isLate)
+            lateSamples += 1;
+
+        block.gapBefore = pendingGap;
+        pendingGap = 0;
+
+        samplesReadThisTask += block.numSamples;
+        lastGoodReadTime = block.readTime;
+
+        recordReadTime (block.numSamples);
+
+        NIDAQ_TRACE_NEXT ("process block");
+
+        processBlock (block);
+
+        stats.recordLoop (Time::getHighResolutionTicks() - loopStart);
+
+        readerCpuSeconds = getThreadCpuSeconds() - cpuSecondsAtStart;
+    }
+}
+
+void NIDAQmx::runProcessing()
+{
+    applyThreadScheduling (processingThread, plan.cpuCore >= 0 ? (plan.cpuCore + 1) % SystemStats::getNumCpus() : -1);
+
+    const double cpuSecondsAtStart = getThreadCpuSeconds();
+    const int64 samplesAtStart = ai_timestamp;
+
+    while (true)
+    {
+        NIDAQ_TRACE_SCOPE (processTrace, "wait for block");
+
+        int start1, size1, start2, size2;
+        blockFifo.prepareToRead (1, start1, size1, start2, size2);
+
+        if (size1 == 0)
+        {
+            if (processingThread->threadShouldExit())
+                break;
+
+            processorWaits += 1;
+            blockReady.wait (PIPELINE_WAIT_MS);
+            continue;
+        }
+
+        NIDAQ_TRACE_NEXT ("process block");
+
+        processBlock (*rawBlocks[start1]);
+
+        blockFifo.finishedRead (1);
+        blockFreed.signal();
+
+        processingCpuSeconds = getThreadCpuSeconds() - cpuSecondsAtStart;
+    }
+
+    if (ai_timestamp > samplesAtStart)
+    {
+        double dataSeconds = (ai_timestamp - samplesAtStart) / plan.sampleRate;
+        double cpuSeconds = getThreadCpuSeconds() - cpuSecondsAtStart;
+
+        LOGC ("NIDAQmx: processing thread used ", cpuSeconds * 1000.0 / dataSeconds, " ms of CPU per second of data");
+    }
+}
@@ -25,12 +25,14 @@
 #define __NIDAQCOMPONENTS_H__
 
 #include <DataThreadHeaders.h>
+#include <atomic>
 #include <stdio.h>
 #include <string.h>
 
 #include "nidaq-api/NIDAQmx.h"
+#include "NIDAQKernels.h"
+#include "NIDAQTrace.h"
 
-#define MAX_NUM_AI_CHANNELS 32
 #define MAX_NUM_DI_CHANNELS 32
 
 #define DEFAULT_NUM_ANALOG_INPUTS 8
@@ -39,10 +41,27 @@
 #define DEFAULT_DIGITAL_PORT 0
 
 #define PORT_SIZE 8
+#define MAX_DIGITAL_LINES 32 // one bit per line in the event word
+
+#define MAX_SCALING_COEFFS 8
 
 #define NUM_SOURCE_TYPES 4
 #define NUM_SAMPLE_RATES 18
-#define CHANNEL_BUFFER_SIZE 500
+#define DATA_BUFFER_SIZE 10000 // samples per channel in each stream's DataBuffer
+#define DEFAULT_TARGET_LATENCY_MS 20
+#define MAX_READ_SIZE_FACTOR 8 // largest catch-up read, in multiples of the target read size
+#define MAX_SAMPLES_PER_READ (DATA_BUFFER_SIZE / 2) // largest read, so that a whole block fits in the DataBuffer
+#define DEFAULT_BUFFER_SECONDS 2.0
+#define PIPELINE_DEPTH 8 // block slots between the reader and processing threads
+#define PIPELINE_WAIT_MS 10
+#define STOP_TIMEOUT_MS 5000 // wait for the acquisition threads to finish a run before logging that stopping is still waiting
+#define DEFAULT_DECIMATION_TAPS 64
+#define NOTCH_Q 20.0 // mains notch bandwidth is the notch frequency / NOTCH_Q
+#define LOW_LATENCY_BLOCK_MS 1 // read size in low-latency mode when single-point timing is unavailable
+#define READ_WATCHDOG_SECONDS 1.0 // shortest wait for a read before the device counts as stalled
+#define MAX_RESTART_ATTEMPTS 5 // consecutive failed restarts before the acquisition gives up
+#define RESTART_BACKOFF_MS 100 // delay before the first restart, doubled for each further attempt
+#define MAX_RESTART_BACKOFF_MS 2000
 #define ERR_BUFF_SIZE 2048
 
 #define STR2CHR(jString) ((jString).toUTF8())
@@ -64,6 +83,15 @@ enum SOURCE_TYPE
     PSEUDO_DIFF
 };
 
+/* Scheduling requested for the acquisition threads */
+enum THREAD_PRIORITY
+{
+    PRIORITY_NORMAL = 0,
+    PRIORITY_HIGH,
+    PRIORITY_REALTIME_RR, // SCHED_RR where permitted, else the highest OS priority
+    PRIORITY_REALTIME_FIFO // SCHED_FIFO where permitted, else the highest OS priority
+};
+
 struct SettingsRange
 {
     NIDAQ::float64 min, max;
@@ -142,6 +170,33 @@ public:
     Array<std::string> digitalPortNames;
     Array<bool> digitalPortStates;
 
+    /* Physical channels and rate limits, filled in once by NIDAQmxDeviceManager::probeDevice */
+    bool isProbed = false;
+    StringArray aiChannelNames;
+    Array<NIDAQ::int32> aiTerminalConfigs;
+    StringArray diLineNames;
+    NIDAQ::float64 minSampleRate = 0;
+    NIDAQ::float64 maxMultiChanRate = 0;
+
+    /* Rates the sample clock really produces, by requested rate and channel count; filled in
+       as combinations are first used, so the driver is only asked once for each */
+    struct CoercedSampleRate
+    {
+        NIDAQ::float64 requested;
+        int numChannels;
+        NIDAQ::float64 coerced;
+    };
+    Array<CoercedSampleRate> coercedSampleRates;
+
+    /* Volts per raw count of each AI channel, by voltage range (0 where the scaling is not a
+       uniform 16-bit step); filled in as ranges are first used for raw recording */
+    struct RawCountSteps
+    {
+        int rangeIndex;
+        Array<NIDAQ::float64> steps;
+    };
+    Array<RawCountSteps> rawCountSteps;
+
 private:
     String name;
 };
@@ -161,6 +216,9 @@ public:
 
     NIDAQDevice* getDeviceFromName (String deviceName);
 
+    /* Reads the device's properties and physical channels from DAQmx; later calls reuse them */
+    static void probeDevice (NIDAQDevice* device);
+
     friend class NIDAQThread;
 
 private:
@@ -168,11 +226,198 @@ private:
     int activeDeviceIndex;
 };
 
+/* Snapshot of the acquisition settings, built once before the acquisition thread starts,
+   with everything the driver decides (coerced rate, single-point support, read sizes) already
+   resolved. The acquisition loop only reads from the plan, so the editor is free to change the
+   live channel settings while a run is in progress. */
+struct AcquisitionPlan
+{
+    NIDAQ::float64 sampleRate = 0;
+    SettingsRange voltageRange;
+
+    /* Analog inputs, in task order */
+    int numAnalogInputs = 0;
+    StringArray analogChannelNames;
+    Array<NIDAQ::int32> terminalConfigs;
+    Array<int> enabledAnalogChannels; // task index of each enabled analog input
+    Array<uint32> analogEnableMasks; // per task index: all ones if enabled, zero otherwise
+    bool useRawSamples = false; // read native ADC counts and scale them in the plugin
+    bool useCallbacks = false; // read from DAQmx every-N-samples callbacks instead of a thread
+    THREAD_PRIORITY threadPriority = PRIORITY_NORMAL; // reader and processing threads
+    int cpuCore = -1; // reader core (processing runs on the next one), -1 for no pinning
+    bool writeClockAnchors = false; // save (sample index, host time) anchors next to the recordings
+    bool traceAcquisition = false; // record loop phases, written as Chrome trace JSON when the run stops
+    bool writeLatencyHistograms = false; // save the latency histograms as CSV when the run stops
+    int decimationFactor = 1; // reduced-rate copy of the analog inputs, 1 for none
+    int decimationTaps = DEFAULT_DECIMATION_TAPS;
+    double highPassCutoff = 0; // Hz, 0 for none
+    double notchFrequency = 0; // Hz, 0 for none
+    bool lowLatency = false; // single-point reads, or LOW_LATENCY_BLOCK_MS blocks as a fallback
+    bool singlePoint = false; // the device accepted hardware-timed single-point timing for these inputs
+
+    /* Digital inputs, by enabled port */
+    uint32 digitalLineMask = 0;
+    int digitalReadSize = 0;
+    StringArray digitalPortNames;
+    Array<int> digitalPortIndices; // hardware index of each port
+    Array<int> digitalPortShifts; // bit offset of each port within the event word
+
+    /* Read sizes */
+    int samplesPerRead = 0; // samples per channel per read, from the target latency
+    int maxSamplesPerRead = 0; // largest read when catching up (equals samplesPerRead unless adaptive)
+    int analogReadSize = 0; // samples per read, across all analog inputs
+    int bufferSize = 0; // DAQmx host input buffer size, in samples per channel
+    double readTimeout = READ_WATCHDOG_SECONDS; // a read waiting longer than this is a stall
+};
+
+/* One DAQmx read: interleaved analog scans (scaled or raw) and the merged digital words */
+struct RawBlock
+{
+    HeapBlock<NIDAQ::float64> ai_data;
+    HeapBlock<NIDAQ::int32> ai_raw;
+    HeapBlock<NIDAQ::uInt32> eventCodes;
+    NIDAQ::int32 numSamples = 0;
+    double readTime = 0; // host clock when the read returned, in seconds
+    int64 gapBefore = 0; // samples lost to a task restart just before this block
+};
+
+/**
+
+    Throughput counters for one device, updated by the acquisition threads and readable
+    from any thread (the editor, getInfoXml, the STATS config message) without a lock.
+
+    Every counter has a single writer (the reader thread or callback for reads, loops,
+    overflows and restarts; the processing thread for conversion and publish times), so
+    relaxed loads and stores are enough and no update needs a locked read-modify-write.
+    Each value is consistent on its own, not with the others.
+
+*/
+class AcquisitionStats
+{
+public:
+    AcquisitionStats() { reset(); }
+
+    /** Clears every counter, before the acquisition threads start */
+    void reset();
+
+    /** A successful driver read of numSamples scans (numBytes in total) taking the given ticks */
+    void recordRead (int64 numSamples, int64 numBytes, int64 ticks);
+
+    /** Conversion, filtering and timestamping of one block */
+    void recordConversion (int64 ticks) { add (conversionTicks, ticks); }
+
+    /** Writing one block to the DataBuffers */
+    void recordPublish (int64 ticks) { add (publishTicks, ticks); }
+
+    /** One pass of the acquisition loop, including the driver wait */
+    void recordLoop (int64 ticks);
+
+    void recordOverflow() { add (overflows, 1); }
+    void recordRestart() { add (restarts, 1); }
+
+    int64 getReads() const { return get (reads); }
+    int64 getSamples() const { return get (samples); }
+    int64 getBytes() const { return get (bytes); }
+    double getReadSeconds() const { return Time::highResolutionTicksToSeconds (get (readTicks)); }
+    double getConversionSeconds() const { return Time::highResolutionTicksToSeconds (get (conversionTicks)); }
+    double getPublishSeconds() const { return Time::highResolutionTicksToSeconds (get (publishTicks)); }
+    double getMaxLoopSeconds() const { return Time::highResolutionTicksToSeconds (get (maxLoopTicks)); }
+    int64 getOverflows() const { return get (overflows); }
+    int64 getRestarts() const { return get (restarts); }
+
+private:
+    static int64 get (const std::atomic<int64>& counter) { return counter.load (std::memory_order_relaxed); }
+    static void add (std::atomic<int64>& counter, int64 amount) { counter.store (get (counter) + amount, std::memory_order_relaxed); }
+
+    std::atomic<int64> reads;
+    std::atomic<int64> samples;
+    std::atomic<int64> bytes;
+    std::atomic<int64> readTicks;
+    std::atomic<int64> conversionTicks;
+    std::atomic<int64> publishTicks;
+    std::atomic<int64> maxLoopTicks;
+    std::atomic<int64> overflows;
+    std::atomic<int64> restarts;
+};
+
+/**
+
+    HDR-style histogram of durations in nanoseconds: exact below 64 ns, then 32 linear
+    sub-buckets per power of two, so every bucket is within about 3% of its values up
+    to about 36 minutes. The counts are a fixed array, so recording never allocates.
+
+    Like AcquisitionStats, each histogram has a single writer thread and uses relaxed
+    atomics, so the editor can summarise it while the acquisition is running.
+
+*/
+class LatencyHistogram
+{
+public:
+    static const int subBucketBits = 6;
+    static const int subBucketHalf = 1 << (subBucketBits - 1);
+    static const int maxMagnitude = 40; // values from 2^41 ns up land in the top bucket
+    static const int numBuckets = (maxMagnitude - subBucketBits + 3) * subBucketHalf;
+
+    struct Summary
+    {
+        int64 count = 0;
+        int64 p50 = 0;
+        int64 p99 = 0;
+        int64 p999 = 0;
+        int64 max = 0;
+    };
+
+    LatencyHistogram() { reset(); }
+
+    /** Clears the histogram, before its writer starts */
+    void reset();
+
+    void record (int64 nanoseconds) noexcept
+    {
+        const uint64 value = uint64 (jmax ((int64) 0, nanoseconds));
+        const int index = jmin (getBucketIndex (value), numBuckets - 1);
+
+        counts[index].store (counts[index].load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (int64 (value) > maxValue.load (std::memory_order_relaxed))
+            maxValue.store (int64 (value), std::memory_order_relaxed);
+    }
+
+    /** Percentiles (upper edges of their buckets) and the exact maximum, in nanoseconds */
+    Summary getSummary() const;
+
+    /** One "name,low_ns,high_ns,count" row per non-empty bucket */
+    void writeCsv (OutputStream& stream, const String& name) const;
+
+    static int getBucketIndex (uint64 value) noexcept
+    {
+        if (value < uint64 (1 << subBucketBits))
+            return int (value);
+
+        const int shift = findHighestSetBit (value) - (subBucketBits - 1);
+        return shift * subBucketHalf + int (value >> shift);
+    }
+
+    /** Smallest value of a bucket; the next bucket starts where it ends */
+    static int64 getBucketStart (int index) noexcept
+    {
+        if (index < (1 << subBucketBits))
+            return index;
+
+        const int shift = index / subBucketHalf - 1;
+        return int64 (index % subBucketHalf + subBucketHalf) << shift;
+    }
+
+private:
+    std::atomic<int64> counts[numBuckets];
+    std::atomic<int64> maxValue;
+};
+
 class NIDAQmx : public Thread
 {
 public:
     NIDAQmx (NIDAQDevice* device_);
-    ~NIDAQmx() {};
+    ~NIDAQmx();
 
     /* Pointer to the active device */
     NIDAQDevice* device;
@@ -184,17 +429,104 @@ public:
     String getProductName() { return device->productName; };
     String getSerialNumber() { return String (device->serialNum); };
 
-    /* Analog configuration */
-    NIDAQ::float64 getSampleRate() { return sampleRates[sampleRateIndex]; };
-    void setSampleRate (int index) { sampleRateIndex = index; };
+    /* Analog configuration: any rate within the device range can be requested (the presets in
+       sampleRates are only suggestions); getSampleRate is the rate the driver coerced it to */
+    NIDAQ::float64 getSampleRate() { return sampleRate; };
+    NIDAQ::float64 getRequestedSampleRate() { return requestedSampleRate; };
+    void setSampleRate (int index);
+    void setCustomSampleRate (NIDAQ::float64 rate);
 
     SettingsRange getVoltageRange() { return device->voltageRanges[voltageRangeIndex]; };
+    int getVoltageRangeIndex() { return voltageRangeIndex; };
     void setVoltageRange (int index) { voltageRangeIndex = index; };
 
+    /* Recorded volts per bit of an analog input at the current voltage range: the channel's own
+       count step for unfiltered raw counts, the range over 16 bits otherwise (and for the decimated stream) */
+    NIDAQ::float64 getBitVolts (int channel, bool decimated = false);
+
+    /* Raw mode reads native ADC counts and applies the device scaling polynomial in the plugin */
+    void setUseRawSamples (bool useRawSamples_) { useRawSamples = useRawSamples_; };
+    bool getUseRawSamples() { return useRawSamples; };
+
+    /* Callback mode reads each block from a DAQmx every-N-samples event instead of the acquisition thread */
+    void setUseCallbacks (bool useCallbacks_) { useCallbacks = useCallbacks_; };
+    bool getUseCallbacks() { return useCallbacks; };
+
+    /* Samples per read are derived from the target latency; adaptive reads grow to drain a backlog */
+    void setTargetLatencyMs (int targetLatencyMs_) { targetLatencyMs = targetLatencyMs_; };
+    int getTargetLatencyMs() { return targetLatencyMs; };
+    void setAdaptiveReads (bool adaptiveReads_) { adaptiveReads = adaptiveReads_; };
+    bool getAdaptiveReads() { return adaptiveReads; };
+
+    /* Samples per channel in the most recent read (0 when not acquiring) */
+    int getLastReadSize() { return lastReadSize.get(); };
+
+    /* Host buffer holds this many seconds of data, to ride out stalls in the GUI */
+    void setBufferSeconds (double bufferSeconds_) { bufferSeconds = bufferSeconds_; };
+    double getBufferSeconds() { return bufferSeconds; };
+
+    /* Host buffer size and its peak occupancy during the current (or last) run, in samples per channel */
+    int getHostBufferSize() { return hostBufferSize.get(); };
+    int getPeakBufferOccupancy() { return peakBufferOccupancy.get(); };
+    int getBufferOccupancy() { return bufferOccupancy.get(); };
+
+    /* Samples waiting in the DataBuffer for the GUI, and its peak during the current (or last) run */
+    int getDataBufferFill() { return dataBufferFill.get(); };
+    int getPeakDataBufferFill() { return peakDataBufferFill.get(); };
+
+    /* Highest host buffer and DataBuffer levels since the last call, which resets them; lets a
+       monitor polling far slower than the reads still see every peak */
+    int takeRecentBufferPeak() { return recentBufferPeak.exchange (0); };
+    int takeRecentDataBufferPeak() { return recentDataBufferPeak.exchange (0); };
+
+    /* Drift of the device sample clock against the host clock (ppm) and the RMS residual
+       of the read anchors around the fit (microseconds), for the current (or last) run */
+    double getClockDriftPpm() { return clockDriftPpm.get(); };
+    double getTimestampJitter() { return timestampJitter.get(); };
+
+    /* Writes the clock anchors of each run to a binary file in the recording directory */
+    void setWriteClockAnchors (bool writeClockAnchors_) { writeClockAnchors = writeClockAnchors_; };
+    bool getWriteClockAnchors() { return writeClockAnchors; };
+
+    /* Records the phases of each read and block, written to a Chrome trace file in the recording
+       directory when the run stops (no effect in builds with NIDAQ_TRACING off) */
+    void setTraceAcquisition (bool traceAcquisition_) { traceAcquisition = traceAcquisition_; };
+    bool getTraceAcquisition() { return traceAcquisition; };
+
+    /* Distributions of driver read durations, block processing durations and the deviation of
+       each read interval from the duration of the data it returned, for the current (or last) run */
+    const LatencyHistogram& getReadDurations() const { return readDurations; };
+    const LatencyHistogram& getProcessDurations() const { return processDurations; };
+    const LatencyHistogram& getReadIntervalErrors() const { return readIntervalErrors; };
+
+    /* Writes the histograms to a CSV file in the recording directory when the run stops */
+    void setWriteLatencyHistograms (bool writeLatencyHistograms_) { writeLatencyHistograms = writeLatencyHistograms_; };
+    bool getWriteLatencyHistograms() { return writeLatencyHistograms; };
+
+    /* CPU time used by the reader and processing threads during the current (or last) run, in
+       seconds (not measured for callbacks, which run on the driver's thread) */
+    double getReaderCpuSeconds() { return readerCpuSeconds.get(); };
+    double getProcessingCpuSeconds() { return processingCpuSeconds.get(); };
+
+    /* Low-pass filtered copy of the analog inputs at sampleRate / factor, published to a second
+       stream (factor 1 for none); taps sets the length of the anti-aliasing filter */
+    void setDecimationFactor (int decimationFactor_) { decimationFactor = jmax (1, decimationFactor_); };
+    int getDecimationFactor() { return decimationFactor; };
+    void setDecimationTaps (int decimationTaps_) { decimationTaps = jmax (1, decimationTaps_); };
+    int getDecimationTaps() { return decimationTaps; };
+    NIDAQ::float64 getDecimatedSampleRate() { return sampleRate / decimationFactor; };
+
+    /* Conditioning applied to every analog input before it is published: a second-order
+       high-pass and a mains notch (either 0 for none) */
+    void setHighPassCutoff (double highPassCutoff_) { highPassCutoff = jmax (0.0, highPassCutoff_); };
+    double getHighPassCutoff() { return highPassCutoff; };
+    void setNotchFrequency (double notchFrequency_) { notchFrequency = jmax (0.0, notchFrequency_); };
+    double getNotchFrequency() { return notchFrequency; };
+
     SOURCE_TYPE getSourceTypeForInput (int analogIntputIndex) { return ai[analogIntputIndex]->getSourceType(); };
     void toggleSourceType (int analogInputIndex) { ai[analogInputIndex]->setNextSourceType(); }
 
-    void setNumActiveAnalogInputs (int numActiveAnalogInputs_) { numActiveAnalogInputs = numActiveAnalogInputs_; };
+    void setNumActiveAnalogInputs (int numActiveAnalogInputs_);
     int getNumActiveAnalogInputs() { return numActiveAnalogInputs; };
 
     /*Digital configuration */
@@ -207,10 +539,63 @@ public:
     /* 32-bit mask indicating which lines are currently enabled */
     uint32 getActiveDigitalLines();
 
+    /* Rising / falling edges on a digital line since acquisition started (lock-free, any thread) */
+    uint32 getRisingEdgeCount (int line) { return isPositiveAndBelow (line, MAX_DIGITAL_LINES) ? risingEdgeCounts[line].get() : 0; };
+    uint32 getFallingEdgeCount (int line) { return isPositiveAndBelow (line, MAX_DIGITAL_LINES) ? fallingEdgeCounts[line].get() : 0; };
+
     int getNumPorts() { return device->digitalPortNames.size(); };
     bool getPortState (int idx) { return device->digitalPortStates[idx]; };
     void setPortState (int idx, bool state) { device->digitalPortStates.set (idx, state); };
 
+    /* Pipeline between the reader (this thread) and the processing thread: blocks waiting
+       in the ring, the most that ever waited, reads delayed by a full ring (processing is the
+       bottleneck) and waits on an empty ring (the driver read is the bottleneck) */
+    int getQueueDepth() { return blockFifo.getNumReady(); };
+    int getPeakQueueDepth() { return peakQueueDepth.get(); };
+    int getReaderStalls() { return readerStalls.get(); };
+    int getProcessorWaits() { return processorWaits.get(); };
+
+    /* Scheduling for the reader and processing threads; cpuCore pins the reader to that core
+       and the processing thread to the next one (-1 leaves placement to the OS) */
+    void setThreadPriority (THREAD_PRIORITY threadPriority_) { threadPriority = threadPriority_; };
+    THREAD_PRIORITY getThreadPriority() { return threadPriority; };
+    void setCpuCore (int cpuCore_) { cpuCore = cpuCore_; };
+    int getCpuCore() { return cpuCore; };
+
+    /* Deviation of the interval between reads from the duration of the data they returned,
+       in microseconds: mean and maximum over the current (or last) run */
+    int getMeanReadJitter() { return meanReadJitter.get(); };
+    int getMaxReadJitter() { return maxReadJitter.get(); };
+
+    /* Low-latency mode: hardware-timed single-point reads, each scan published as soon as its
+       sample clock arrives, or LOW_LATENCY_BLOCK_MS blocks where the device cannot time single points */
+    void setLowLatency (bool lowLatency_) { lowLatency = lowLatency_; };
+    bool getLowLatency() { return lowLatency; };
+
+    /* Sample clocks the reader woke up too late for, in single-point mode */
+    int getLateSamples() { return lateSamples.get(); };
+
+    /* Age of the oldest sample of each block when it reaches the DataBuffer (buffering plus
+       processing, with sample times from the clock fit), in microseconds: mean and maximum */
+    int getMeanPublishLatency() { return meanPublishLatency.get(); };
+    int getMaxPublishLatency() { return maxPublishLatency.get(); };
+
+    /* Recovery from overflows, stalls and driver errors during the current (or last) run: task
+       restarts, gaps left in the sample numbering and the samples they skipped */
+    int getNumRestarts() { return int (stats.getRestarts()); };
+    int getNumGaps() { return numGaps.get(); };
+    int64 getLostSamples() { return lostSamples.get(); };
+
+    /* Reads, throughput and where the time goes, for the current (or last) run */
+    const AcquisitionStats& getStats() const { return stats; };
+
+    /* Snapshots the current settings into the plan used by the next run */
+    void createAcquisitionPlan();
+
+    /* Starts the acquisition thread, or the tasks and their callback in callback mode */
+    bool startAcquisition();
+    void stopAcquisition();
+
     void run();
 
     Array<NIDAQ::float64> sampleRates;
@@ -225,24 +610,241 @@ private:
     ScopedPointer<NIDAQmxDeviceManager> dm;
 
     int deviceIndex = 0;
-    int sampleRateIndex = 0;
+    int sampleRateIndex = 0; // preset index, -1 for a custom rate
     int voltageRangeIndex = 0;
 
+    NIDAQ::float64 requestedSampleRate = 0;
+    NIDAQ::float64 sampleRate = 0; // requestedSampleRate as coerced for numActiveAnalogInputs channels
+
+    /* Resolves sampleRate, through the device's cache of coerced rates */
+    void updateSampleRate();
+
+    /* Commits a throwaway task with numChannels inputs at the requested rate and reads back the rate the sample clock can really produce (0 on failure) */
+    NIDAQ::float64 queryCoercedSampleRate (NIDAQ::float64 rate, int numChannels);
+
+    /* Volts per raw count of an input at the current range, through the device's cache */
+    NIDAQ::float64 getRawCountStep (int channel);
+
+    /* Commits a throwaway task with every input at a range and reads back their scaling polynomials (empty on failure) */
+    Array<NIDAQ::float64> queryRawCountSteps (int rangeIndex);
+
     int digitalReadSize = 0;
 
+    bool useRawSamples = false;
+    bool useCallbacks = false;
+
+    THREAD_PRIORITY threadPriority = PRIORITY_NORMAL;
+    int cpuCore = -1;
+
+    void applyThreadScheduling (Thread* thread, int core);
+
+    /* Read timing: reader thread only, published through the atomics */
+    void recordReadTime (int numSamples);
+    int64 lastReadTicks = 0;
+    double jitterSum = 0;
+    int64 jitterCount = 0;
+    Atomic<int> meanReadJitter;
+    Atomic<int> maxReadJitter;
+
+    bool lowLatency = false;
+    Atomic<int> lateSamples;
+
+    /* Publish latency: processing side only, published through the atomics */
+    void recordPublishLatency (double oldestSampleTime);
+    double latencySum = 0;
+    int64 latencyCount = 0;
+    Atomic<int> meanPublishLatency;
+    Atomic<int> maxPublishLatency;
+
+    int targetLatencyMs = DEFAULT_TARGET_LATENCY_MS;
+    bool adaptiveReads = false;
+    Atomic<int> lastReadSize;
+
+    double bufferSeconds = DEFAULT_BUFFER_SECONDS;
+    Atomic<int> hostBufferSize;
+    Atomic<int> bufferOccupancy;
+    Atomic<int> peakBufferOccupancy;
+    Atomic<int> recentBufferPeak;
+
+    Atomic<int> dataBufferFill;
+    Atomic<int> peakDataBufferFill;
+    Atomic<int> recentDataBufferPeak;
+    void updateDataBufferFill();
+
     int numActiveAnalogInputs = DEFAULT_NUM_ANALOG_INPUTS; // 8
     int numActiveDigitalInputs = DEFAULT_NUM_DIGITAL_INPUTS; // 8
 
-    HeapBlock<NIDAQ::float64> ai_data;
-
-    HeapBlock<NIDAQ::uInt32> eventCodes;
+    /* Written only by createAcquisitionPlan, before the run starts; everything else reads it through plan */
+    AcquisitionPlan acquisitionPlan;
+    const AcquisitionPlan& plan { acquisitionPlan };
+
+    /* Rate the committed AI task's sample clock reports (the plan holds the rate announced to the stream) */
+    NIDAQ::float64 taskSampleRate = 0;
+
+    /* Acquisition steps, shared by the thread loop and the callback */
+    void prepareBlocks();
+    bool createTasks();
+    bool createMultiPortDITask (const char* trigName);
+    static NIDAQ::int32 configureSinglePointTiming (NIDAQ::TaskHandle task, NIDAQ::float64 rate);
+    bool probeSinglePointTiming (const AcquisitionPlan& newPlan);
+    void runSinglePoint();
+    void superviseCallbacks();
+    bool startTasks();
+    bool startTaskHandles();
+    void releaseTasks();
+    void updateBufferOccupancy();
+    int getNextReadSize();
+    NIDAQ::int32 readBlock (RawBlock& block, int numSampsPerChan, NIDAQ::float64 timeout);
+    void holdDigitalWord (NIDAQ::uInt32* eventCodes, int numRead, int numScans);
+    void processBlock (const RawBlock& block);
+    void clearTasks();
+
+    /* Reader side (or the callback supervisor): restarts the tasks after a failed read, with
+       bounded backoff, and works out how many samples the outage cost (handed to processing
+       through RawBlock::gapBefore) */
+    bool recoverAcquisition (NIDAQ::int32 error);
+    int64 samplesReadThisTask = 0;
+    double lastGoodReadTime = 0;
+    int64 pendingGap = 0;
+
+    /* Processing side: skips the lost sample numbers and reports the gap */
+    void recordGap (int64 numSamples);
+    int getBytesPerScan() const;
+
+    Atomic<int> numGaps;
+    AcquisitionStats stats;
+    Atomic<int64> lostSamples;
+
+    static NIDAQ::int32 CVICALLBACK everyNSamplesCallback (NIDAQ::TaskHandle taskHandle, NIDAQ::int32 everyNsamplesEventType, NIDAQ::uInt32 nSamples, void* callbackData);
+    NIDAQ::int32 handleSamplesReady (NIDAQ::uInt32 nSamples);
+
+    /* Single task to handle all analog inputs */
+    NIDAQ::TaskHandle taskHandleAI = 0;
+
+    /* Potentially multiple tasks to handle different digital line properties */
+    std::vector<NIDAQ::TaskHandle> taskHandlesDI;
+
+    /* All enabled ports in one task (taskHandlesDI[0]), merged into the event word by the packer */
+    bool multiPortDI = false;
+    PortPacker portPacker;
+
+    /* Held by the callback while it reads, so stopping can wait for it; a failed callback
+       disables the callbacks and leaves its error for superviseCallbacks() */
+    CriticalSection callbackLock;
+    bool callbacksEnabled = false;
+    NIDAQ::int32 callbackError = 0;
+
+    /* Reads land in preallocated block slots; the ring hands them from the reader to the
+       processing thread (the callback path only ever uses the first slot) */
+    class ProcessingThread : public Thread
+    {
+    public:
+        ProcessingThread (NIDAQmx* owner_) : Thread ("NIDAQmx Processing"), owner (owner_) {}
+        void run() override { owner->runProcessing(); }
+
+    private:
+        NIDAQmx* owner;
+    };
+
+    void runProcessing();
+
+    ScopedPointer<ProcessingThread> processingThread;
+    OwnedArray<RawBlock> rawBlocks;
+    AbstractFifo blockFifo { PIPELINE_DEPTH };
+    WaitableEvent blockReady;
+    WaitableEvent blockFreed;
+
+    Atomic<int> peakQueueDepth;
+    Atomic<int> readerStalls;
+    Atomic<int> processorWaits;
+
+    int rawSampleSize = 16;
+
+    /* Raw mode: native ADC counts (16- or 32-bit) and per-channel scaling polynomials */
+    HeapBlock<NIDAQ::float64> scalingCoeffs;
+    int numScalingCoeffs = 0;
+
+    /* Vectorized scan conversion (scaled volts, or 16-bit counts with short polynomials) */
+    SampleConverter converter;
+    bool useConverterForRaw = false;
+
+    HeapBlock<NIDAQ::uInt32> di_data;
+
+    /* Reader side: last event word read, held over scans the digital read did not return */
+    NIDAQ::uInt32 lastDigitalWord = 0;
+
+    /* One read worth of samples, published to the DataBuffer in a single call */
+    HeapBlock<float> aiBlock;
+    HeapBlock<int64> sampleNumbers;
+    HeapBlock<double> timestamps;
+    HeapBlock<uint64> eventCodeBlock;
+
+    /* Per-sample host timestamps, from the clock fit; processing side only except the atomics */
+    SampleClockFit clockFit;
+    RampFiller rampFiller;
+    Atomic<double> clockDriftPpm;
+    Atomic<double> timestampJitter;
+
+    bool writeClockAnchors = false;
+
+    /* Phase tracing: one ring per recording thread, null pointers while tracing is off */
+    bool traceAcquisition = false;
+    TraceRing readerRing;
+    TraceRing processingRing;
+    TraceRing* readerTrace = nullptr;
+    TraceRing* processTrace = nullptr;
+    int64 traceOriginTicks = 0;
+    void prepareTrace();
+    void writeTrace();
+
+    bool writeLatencyHistograms = false;
+    LatencyHistogram readDurations;
+    LatencyHistogram processDurations;
+    LatencyHistogram readIntervalErrors;
+    void writeHistograms();
+
+    Atomic<double> readerCpuSeconds;
+    Atomic<double> processingCpuSeconds;
+    ScopedPointer<FileOutputStream> anchorStream;
+
+    void openAnchorFile();
+
+    /* Decimated stream: filter state and one read worth of output */
+    int decimationFactor = 1;
+    int decimationTaps = DEFAULT_DECIMATION_TAPS;
+    Decimator decimator;
+    HeapBlock<float> decimatedBlock;
+    HeapBlock<int> decimatedIndices;
+    HeapBlock<int64> decimatedSampleNumbers;
+    HeapBlock<double> decimatedTimestamps;
+    HeapBlock<uint64> decimatedEventCodes;
+    int64 decimatedSampleCount = 0;
+
+    void processDecimatedBlock (int numSamples);
+
+    /* High-pass and notch sections, run in place on aiBlock; state persists for the whole run */
+    double highPassCutoff = 0;
+    double notchFrequency = 0;
+    BiquadBank filterBank;
+
+    void prepareFilterBank();
 
     int64 ai_timestamp;
     uint64 eventCode;
 
-    std::map<int, int> digitalLineMap;
+    /* Edges seen on each digital line since the run started; written by the acquisition thread only */
+    Atomic<uint32> risingEdgeCounts[MAX_DIGITAL_LINES];
+    Atomic<uint32> fallingEdgeCounts[MAX_DIGITAL_LINES];
+
+    void countDigitalEdges (int numTransitions);
+
+    /* Samples where the masked digital word changed within the current block */
+    TransitionDetector transitionDetector;
+    HeapBlock<int> transitionIndices;
+    HeapBlock<uint32> transitionWords;
 
     DataBuffer* aiBuffer;
+    DataBuffer* decimatedBuffer = nullptr;
 };
 
 #endif // __NIDAQCOMPONENTS_H__
\ No newline at end of file
@@ -24,15 +24,17 @@
 #include "NIDAQEditor.h"
 #include "NIDAQThread.h"
 
-EditorBackground::EditorBackground (int nAI, int nDI) : nAI (nAI), nDI (nDI) {}
+EditorBackground::EditorBackground (int nAI, int nDI, int firstAI, int totalAI)
+    : nAI (nAI), nDI (nDI), firstAI (firstAI), totalAI (totalAI) {}
 
 void EditorBackground::paint (Graphics& g)
 {
     if (nAI > 0 || nDI > 0)
     {
-        /* Draw AI channels */
+        /* Draw AI channels (paged devices are laid out for a full page) */
+        const int layoutAI = totalAI > nAI ? AI_CHANNELS_PER_PAGE : nAI;
         int maxChannelsPerColumn = 4;
-        int aiChannelsPerColumn = nAI > 0 && nAI < maxChannelsPerColumn ? nAI : maxChannelsPerColumn;
+        int aiChannelsPerColumn = layoutAI > 0 && layoutAI < maxChannelsPerColumn ? layoutAI : maxChannelsPerColumn;
         int diChannelsPerColumn = nDI > 0 && nDI < maxChannelsPerColumn ? nDI : maxChannelsPerColumn;
 
         float aiChanOffsetX = 15; //pixels
@@ -76,7 +78,7 @@ void EditorBackground::paint (Graphics& g)
             g.setColour (findColour (ThemeColours::defaultText));
             g.setFont (10);
             g.drawText (
-                String ("AI") + String (i),
+                String ("AI") + String (firstAI + i),
                 5 + aiChanOffsetX + paddingX * colIndex * aiChanWidth,
                 7 + aiChanOffsetY + paddingY * rowIndex * aiChanHeight,
                 20,
@@ -92,7 +94,7 @@ void EditorBackground::paint (Graphics& g)
         }
 
         /* Draw DI lines */
-        float diChanOffsetX = aiChanOffsetX + ((nAI % maxChannelsPerColumn == 0 ? 0 : 1) + nAI / aiChannelsPerColumn) * paddingX * aiChanWidth;
+        float diChanOffsetX = aiChanOffsetX + ((layoutAI % maxChannelsPerColumn == 0 ? 0 : 1) + layoutAI / aiChannelsPerColumn) * paddingX * aiChanWidth;
         float diChanOffsetY = aiChanOffsetY;
         float diChanWidth = 42;
         float diChanHeight = 22;
@@ -133,6 +135,15 @@ void EditorBackground::paint (Graphics& g)
                 Justification::centredLeft);
         }
 
+        /* Range shown, between the page buttons */
+        if (totalAI > nAI)
+        {
+            g.setColour (findColour (ThemeColours::defaultText));
+            g.setFont (10);
+            g.drawText ("AI" + String (firstAI) + "-" + String (firstAI + nAI - 1) + " of " + String (totalAI),
+                        62, 118, 88, 12, Justification::centred);
+        }
+
         //FIFO monitor label
         float settingsOffsetX = diChanOffsetX + ((nDI % maxChannelsPerColumn == 0 ? 0 : 1) + nDI / diChannelsPerColumn) * paddingX * diChanWidth + 5;
         g.setColour (findColour (ThemeColours::defaultText));
@@ -152,19 +163,45 @@ void EditorBackground::paint (Graphics& g)
     }
 }
 
-FifoMonitor::FifoMonitor (NIDAQThread* thread_) : thread (thread_), fillPercentage (0.0)
+FifoMonitor::FifoMonitor (NIDAQThread* thread_) : thread (thread_)
 {
-    startTimer (500); // update fill percentage every 0.5 seconds
+    startTimer (FIFO_MONITOR_INTERVAL_MS);
 }
 
-void FifoMonitor::timerCallback()
+void FifoMonitor::PeakHold::update (float fill)
 {
-    //TODO:
+    if (fill >= peak)
+    {
+        peak = fill;
+        ticksLeft = FIFO_PEAK_HOLD_MS / FIFO_MONITOR_INTERVAL_MS;
+    }
+    else if (--ticksLeft <= 0)
+    {
+        peak = fill;
+    }
 }
 
-void FifoMonitor::setFillPercentage (float fill_)
+void FifoMonitor::timerCallback()
 {
-    fillPercentage = fill_;
+    // Only atomics are read here; the acquisition threads never wait on the message thread
+    const int hostBufferSize = thread->getHostBufferSize();
+
+    hostFill = hostBufferSize > 0 ? float (thread->getBufferOccupancy()) / hostBufferSize : 0.0f;
+    dataFill = float (thread->getDataBufferFill()) / DATA_BUFFER_SIZE;
+
+    hostPeak.update (hostBufferSize > 0 ? float (thread->takeRecentBufferPeak()) / hostBufferSize : 0.0f);
+    dataPeak.update (float (thread->takeRecentDataBufferPeak()) / DATA_BUFFER_SIZE);
+
+    String tooltip = "Host buffer backlog / GUI DataBuffer fill";
+
+    if (hostBufferSize > 0)
+        tooltip += "\nHost buffer: " + String (thread->getBufferOccupancy()) + " of " + String (hostBufferSize)
+                   + " samples, run peak " + String (thread->getPeakBufferOccupancy());
+
+    tooltip += "\nDataBuffer: " + String (thread->getDataBufferFill()) + " of " + String (DATA_BUFFER_SIZE)
+               + " samples, run peak " + String (thread->getPeakDataBufferFill());
+
+    setTooltip (tooltip);
 
     repaint();
 }
@@ -172,17 +209,115 @@ void FifoMonitor::setFillPercentage (float fill_)
 void FifoMonitor::paint (Graphics& g)
 {
     g.setColour (Colours::grey);
-    g.fillRoundedRectangle (0, 0, this->getWidth(), this->getHeight(), 4);
+    g.fillRoundedRectangle (0, 0, getWidth(), getHeight(), 3);
+
+    const int barHeight = (getHeight() - 3) / 2;
+
+    paintBar (g, 1, barHeight, hostFill, hostPeak.peak);
+    paintBar (g, 2 + barHeight, barHeight, dataFill, dataPeak.peak);
+}
+
+void FifoMonitor::paintBar (Graphics& g, int y, int height, float fill, float peak)
+{
+    const float width = float (getWidth() - 2);
+
     g.setColour (Colours::lightslategrey);
-    g.fillRoundedRectangle (2, 2, this->getWidth() - 4, this->getHeight() - 4, 2);
+    g.fillRect (1.0f, float (y), width, float (height));
+
+    g.setColour (peak >= FIFO_WARNING_FILL ? Colours::orange : Colours::yellow);
+    g.fillRect (1.0f, float (y), width * jlimit (0.0f, 1.0f, fill), float (height));
 
-    g.setColour (Colours::yellow);
-    float barHeight = (this->getHeight() - 4) * fillPercentage;
-    g.fillRoundedRectangle (2, this->getHeight() - 2 - barHeight, this->getWidth() - 4, barHeight, 2);
+    // Held peak
+    if (peak > 0.0f)
+        g.fillRect (1.0f + (width - 1.0f) * jlimit (0.0f, 1.0f, peak), float (y), 1.0f, float (height));
+}
+
+static String formatSummary (const LatencyHistogram::Summary& summary)
+{
+    return String (summary.p50 / 1000.0, 1) + " / " + String (summary.p99 / 1000.0, 1) + " / "
+           + String (summary.p999 / 1000.0, 1) + " / " + String (summary.max / 1000.0, 1);
+}
+
+LatencyMonitor::LatencyMonitor (NIDAQThread* thread_) : thread (thread_)
+{
+    timerCallback();
+    startTimer (500);
+}
+
+void LatencyMonitor::timerCallback()
+{
+    float sampleRate = thread->getSampleRate();
+    int blockSize = thread->getLastReadSize();
+
+    // Show the configured block until the first read of a run
+    if (blockSize == 0)
+        blockSize = jmax (1, roundToInt (sampleRate * (thread->getLowLatency() ? LOW_LATENCY_BLOCK_MS : thread->getTargetLatencyMs()) / 1000.0));
+
+    // Measured latency once there is one, otherwise the duration of a block
+    const int publishLatency = thread->getMeanPublishLatency();
+    const double latencyMs = publishLatency > 0 ? publishLatency / 1000.0 : blockSize * 1000.0 / sampleRate;
+
+    String newText = String (latencyMs, latencyMs < 1.0 ? 2 : 1) + " ms / " + String (blockSize) + " S";
+    bool newLate = thread->getLateSamples() > 0 || thread->getNumGaps() > 0;
+
+    if (newText != text || newLate != late)
+    {
+        text = newText;
+        late = newLate;
+        repaint();
+    }
+
+    String tooltip = "Read latency / samples per channel per read";
+
+    if (publishLatency > 0)
+        tooltip += "\nPublish latency: " + String (publishLatency) + " us mean, " + String (thread->getMaxPublishLatency()) + " us max (oldest sample of each block)";
+
+    if (thread->getLowLatency())
+        tooltip += "\nLow-latency mode: " + String (thread->getLateSamples()) + " late sample clocks";
+
+    if (thread->getNumRestarts() > 0)
+        tooltip += "\nRestarts: " + String (thread->getNumRestarts()) + ", " + String (thread->getNumGaps()) + " gaps, "
+                   + String (thread->getLostSamples()) + " samples lost";
+
+    if (thread->getHostBufferSize() > 0)
+        tooltip += "\nHost buffer: " + String (thread->getHostBufferSize()) + " samples, peak " + String (thread->getPeakBufferOccupancy());
+
+    if (thread->getPeakQueueDepth() > 0)
+        tooltip += "\nQueue: " + String (thread->getQueueDepth()) + " blocks (peak " + String (thread->getPeakQueueDepth())
+                   + "), " + String (thread->getReaderStalls()) + " reader stalls";
+
+    if (thread->getMaxReadJitter() > 0)
+        tooltip += "\nRead jitter: " + String (thread->getMeanReadJitter()) + " us mean, " + String (thread->getMaxReadJitter()) + " us max";
+
+    const LatencyHistogram::Summary reads = thread->getReadDurations().getSummary();
+
+    if (reads.count > 0)
+    {
+        tooltip += "\nPercentiles (p50 / p99 / p99.9 / max, us):";
+        tooltip += "\n  Read " + formatSummary (reads);
+        tooltip += "\n  Processing " + formatSummary (thread->getProcessDurations().getSummary());
+        tooltip += "\n  Interval error " + formatSummary (thread->getReadIntervalErrors().getSummary());
+    }
+
+    if (thread->getTimestampJitter() > 0)
+        tooltip += "\nClock drift: " + String (thread->getClockDriftPpm(), 1) + " ppm, timestamp jitter " + String (thread->getTimestampJitter(), 0) + " us RMS";
+
+    setTooltip (tooltip);
+}
+
+void LatencyMonitor::paint (Graphics& g)
+{
+    g.setColour (late ? Colours::orange : findColour (ThemeColours::defaultText));
+    g.setFont (9);
+    g.drawText (text, 0, 0, getWidth(), getHeight(), Justification::centredLeft);
 }
 
 AIButton::AIButton (int id_, NIDAQThread* thread_) : id (id_), thread (thread_), enabled (true)
 {
+    // Buttons are rebuilt on every page change, so they start from the channel's state
+    if (auto* input = thread->mNIDAQ->ai[id])
+        enabled = input->isEnabled();
+
     startTimer (500);
 }
 
@@ -262,7 +397,9 @@ void DIButton::paintButton (Graphics& g, bool isMouseOver, bool isButtonDown)
 
     if (enabled && thread->inputAvailable)
     {
-        if (isMouseOver)
+        if (active)
+            g.setColour (Colours::yellow);
+        else if (isMouseOver)
             g.setColour (Colours::lightgreen);
         else
             g.setColour (Colours::forestgreen);
@@ -279,6 +416,14 @@ void DIButton::paintButton (Graphics& g, bool isMouseOver, bool isButtonDown)
 
 void DIButton::timerCallback()
 {
+    uint32 edgeCount = thread->getRisingEdgeCount (id) + thread->getFallingEdgeCount (id);
+    bool wasActive = active;
+
+    active = edgeCount != lastEdgeCount;
+    lastEdgeCount = edgeCount;
+
+    if (active != wasActive)
+        repaint();
 }
 
 SourceTypeButton::SourceTypeButton (int id_, NIDAQThread* thread_, SOURCE_TYPE source) : id (id_), thread (thread_)
@@ -366,8 +511,20 @@ void NIDAQEditor::draw()
         nDI = t->getNumActiveDigitalInputs();
     }
 
+    // Devices with more analog inputs than fit show them a page at a time
+    const int totalAI = nAI;
+    const int numAIPages = jmax (1, (totalAI + AI_CHANNELS_PER_PAGE - 1) / AI_CHANNELS_PER_PAGE);
+
+    aiPage = jlimit (0, numAIPages - 1, aiPage);
+
+    const int firstAI = aiPage * AI_CHANNELS_PER_PAGE;
+    nAI = jmin (AI_CHANNELS_PER_PAGE, totalAI - firstAI);
+
+    // Paged devices keep the width of a full page, so the controls stay put from page to page
+    const int layoutAI = numAIPages > 1 ? AI_CHANNELS_PER_PAGE : nAI;
+
     int maxChannelsPerColumn = 4;
-    int aiChannelsPerColumn = nAI > 0 && nAI < maxChannelsPerColumn ? nAI : maxChannelsPerColumn;
+    int aiChannelsPerColumn = layoutAI > 0 && layoutAI < maxChannelsPerColumn ? layoutAI : maxChannelsPerColumn;
     int diChannelsPerColumn = nDI > 0 && nDI < maxChannelsPerColumn ? nDI : maxChannelsPerColumn;
 
     aiButtons.clear();
@@ -378,12 +535,13 @@ void NIDAQEditor::draw()
     // Draw analog inputs
     for (int i = 0; i < nAI; i++)
     {
+        const int channel = firstAI + i;
         int colIndex = i / aiChannelsPerColumn;
         int rowIndex = i % aiChannelsPerColumn + 1;
         xOffset = colIndex * 86 + 40;
         int y_pos = 4 + rowIndex * 26;
 
-        AIButton* a = new AIButton (i, thread);
+        AIButton* a = new AIButton (channel, thread);
         a->setBounds (xOffset, y_pos, 15, 15);
         a->addListener (this);
         addAndMakeVisible (a);
@@ -391,9 +549,9 @@ void NIDAQEditor::draw()
 
         SOURCE_TYPE sourceType = SOURCE_TYPE::RSE;
         if (thread->foundInputSource())
-            sourceType = thread->getSourceTypeForInput (i);
+            sourceType = thread->getSourceTypeForInput (channel);
 
-        SourceTypeButton* b = new SourceTypeButton (i, thread, sourceType);
+        SourceTypeButton* b = new SourceTypeButton (channel, thread, sourceType);
         b->setBounds (xOffset + 17, y_pos - 1, 32, 17);
         b->changeWidthToFitText();
         b->addListener (this);
@@ -402,6 +560,9 @@ void NIDAQEditor::draw()
         sourceTypeButtons.add (b);
     }
 
+    if (numAIPages > 1)
+        xOffset = ((layoutAI - 1) / aiChannelsPerColumn) * 86 + 40;
+
     diButtons.clear();
 
     // Draw digital inputs
@@ -409,7 +570,7 @@ void NIDAQEditor::draw()
     {
         int colIndex = i / diChannelsPerColumn;
         int rowIndex = i % diChannelsPerColumn + 1;
-        xOffset = ((nAI % maxChannelsPerColumn == 0 ? 0 : 1) + nAI / aiChannelsPerColumn) * 86 + 38 + colIndex * 45;
+        xOffset = ((layoutAI % maxChannelsPerColumn == 0 ? 0 : 1) + layoutAI / aiChannelsPerColumn) * 86 + 38 + colIndex * 45;
         int y_pos = 5 + rowIndex * 26;
 
         DIButton* b = new DIButton (i, thread);
@@ -443,9 +604,10 @@ void NIDAQEditor::draw()
     {
         sampleRateSelectBox->addItem (String (sampleRates[i]) + " S/s", i + 1);
     }
-    sampleRateSelectBox->setSelectedItemIndex (t->getSampleRateIndex(), false);
+    sampleRateSelectBox->setEditableText (true);
     sampleRateSelectBox->addListener (this);
     addAndMakeVisible (sampleRateSelectBox);
+    updateSampleRateText();
 
     voltageRangeSelectBox = new ComboBox ("VoltageRangeSelectBox");
     voltageRangeSelectBox->setBounds (xOffset, 105, 85, 20);
@@ -461,8 +623,12 @@ void NIDAQEditor::draw()
     addAndMakeVisible (voltageRangeSelectBox);
 
     fifoMonitor = new FifoMonitor (thread);
-    fifoMonitor->setBounds (xOffset + 2, 105, 70, 12);
-    //addAndMakeVisible(fifoMonitor);
+    fifoMonitor->setBounds (xOffset + 2, 139, 83, 7);
+    addAndMakeVisible (fifoMonitor);
+
+    latencyMonitor = new LatencyMonitor (thread);
+    latencyMonitor->setBounds (xOffset + 2, 127, 85, 10);
+    addAndMakeVisible (latencyMonitor);
 
     configureDeviceButton = new UtilityButton ("...");
     configureDeviceButton->setFont (FontOptions ((12.0f)));
@@ -471,10 +637,42 @@ void NIDAQEditor::draw()
     configureDeviceButton->setAlpha (0.5f);
     addAndMakeVisible (configureDeviceButton);
 
+    deviceListButton = new UtilityButton ("+");
+    deviceListButton->setFont (FontOptions ((12.0f)));
+    deviceListButton->setBounds (xOffset + 34, 25, 24, 12);
+    deviceListButton->addListener (this);
+    deviceListButton->setAlpha (0.5f);
+    deviceListButton->setTooltip ("Devices acquired by this plugin (" + String (t->getNumAcquiredDevices()) + ")");
+    addAndMakeVisible (deviceListButton);
+
+    if (numAIPages > 1)
+    {
+        prevAIPageButton = new UtilityButton ("<");
+        prevAIPageButton->setFont (FontOptions ((12.0f)));
+        prevAIPageButton->setBounds (40, 133, 20, 12);
+        prevAIPageButton->addListener (this);
+        prevAIPageButton->setAlpha (0.5f);
+        prevAIPageButton->setEnabled (aiPage > 0);
+        addAndMakeVisible (prevAIPageButton);
+
+        nextAIPageButton = new UtilityButton (">");
+        nextAIPageButton->setFont (FontOptions ((12.0f)));
+        nextAIPageButton->setBounds (152, 133, 20, 12);
+        nextAIPageButton->addListener (this);
+        nextAIPageButton->setAlpha (0.5f);
+        nextAIPageButton->setEnabled (aiPage < numAIPages - 1);
+        addAndMakeVisible (nextAIPageButton);
+    }
+    else
+    {
+        prevAIPageButton = nullptr;
+        nextAIPageButton = nullptr;
+    }
+
     desiredWidth = xOffset + 100;
 
-    background = new EditorBackground (nAI, nDI);
-    background->setBounds (0, 15, 1000, 150);
+    background = new EditorBackground (nAI, nDI, firstAI, totalAI);
+    background->setBounds (0, 15, jmax (1000, desiredWidth), 150);
     addAndMakeVisible (background);
     background->toBack();
     background->repaint();
@@ -511,10 +709,79 @@ void NIDAQEditor::update (int numAnalog, int numDigital, int digitalReadSize)
     draw();
 }
 
+void NIDAQEditor::setDecimationFactor (int factor)
+{
+    if (factor == thread->getDecimationFactor())
+        return;
+
+    /* Adds or removes the decimated stream */
+    thread->setDecimationFactor (factor);
+
+    CoreServices::updateSignalChain (this);
+}
+
+/* The sample format and filters decide the channels' bitVolts */
+void NIDAQEditor::setUseRawSamples (bool useRawSamples)
+{
+    if (useRawSamples == thread->getUseRawSamples())
+        return;
+
+    thread->setUseRawSamples (useRawSamples);
+
+    CoreServices::updateSignalChain (this);
+}
+
+void NIDAQEditor::setHighPassCutoff (double cutoff)
+{
+    if (cutoff == thread->getHighPassCutoff())
+        return;
+
+    thread->setHighPassCutoff (cutoff);
+
+    CoreServices::updateSignalChain (this);
+}
+
+void NIDAQEditor::setNotchFrequency (double frequency)
+{
+    if (frequency == thread->getNotchFrequency())
+        return;
+
+    thread->setNotchFrequency (frequency);
+
+    CoreServices::updateSignalChain (this);
+}
+
 NIDAQEditor::~NIDAQEditor()
 {
 }
 
+static String formatSampleRate (double rate)
+{
+    if (rate == std::floor (rate))
+        return String (int64 (rate)) + " S/s";
+
+    return String (rate, 3) + " S/s";
+}
+
+void NIDAQEditor::updateSampleRateText()
+{
+    const double requested = thread->getRequestedSampleRate();
+    const float actual = thread->getSampleRate();
+
+    if (thread->getSampleRateIndex() >= 0 && actual == float (requested))
+        sampleRateSelectBox->setSelectedItemIndex (thread->getSampleRateIndex(), dontSendNotification);
+    else
+        sampleRateSelectBox->setText (formatSampleRate (actual), dontSendNotification);
+
+    SettingsRange range = thread->getSampleRateRange();
+    String tooltip = "Pick a rate or type any rate from " + formatSampleRate (range.min) + " to " + formatSampleRate (range.max);
+
+    if (actual != float (requested))
+        tooltip += "\nRequested " + formatSampleRate (requested) + ", the sample clock runs at " + formatSampleRate (actual);
+
+    sampleRateSelectBox->setTooltip (tooltip);
+}
+
 void NIDAQEditor::startAcquisition()
 {
     //Disable all source type buttons
@@ -526,8 +793,9 @@ void NIDAQEditor::startAcquisition()
     sampleRateSelectBox->setEnabled (false);
     voltageRangeSelectBox->setEnabled (false);
 
-    //Disable device config button
+    //Disable device config buttons
     configureDeviceButton->setEnabled (false);
+    deviceListButton->setEnabled (false);
 }
 
 void NIDAQEditor::stopAcquisition()
@@ -541,8 +809,9 @@ void NIDAQEditor::stopAcquisition()
     sampleRateSelectBox->setEnabled (true);
     voltageRangeSelectBox->setEnabled (true);
 
-    //Enable device config button
+    //Enable device config buttons
     configureDeviceButton->setEnabled (true);
+    deviceListButton->setEnabled (true);
 }
 
 /** Respond to button presses */
@@ -574,12 +843,18 @@ void NIDAQEditor::comboBoxChanged (ComboBox* comboBox)
     {
         if (! thread->isThreadRunning())
         {
-            thread->setSampleRate (comboBox->getSelectedId() - 1);
+            // A typed rate has no item id
+            if (comboBox->getSelectedId() > 0)
+                thread->setSampleRate (comboBox->getSelectedId() - 1);
+            else if (comboBox->getText().getDoubleValue() > 0)
+                thread->setCustomSampleRate (comboBox->getText().getDoubleValue());
+
+            updateSampleRateText();
             CoreServices::updateSignalChain (this);
         }
         else
         {
-            comboBox->setSelectedItemIndex (thread->getSampleRateIndex());
+            updateSampleRateText();
         }
     }
     else // (comboBox == voltageRangeSelectBox)
@@ -616,6 +891,20 @@ void NIDAQEditor::buttonEvent (Button* button)
         ((SourceTypeButton*) button)->update (next);
         repaint();
     }
+    else if (button != nullptr && (button == prevAIPageButton || button == nextAIPageButton))
+    {
+        aiPage += button == nextAIPageButton ? 1 : -1;
+        draw();
+
+        // draw() rebuilds the device controls, which stay locked while acquiring
+        if (thread->isThreadRunning())
+            startAcquisition();
+    }
+    else if (button == deviceListButton)
+    {
+        if (! thread->isThreadRunning())
+            showDeviceMenu();
+    }
     else if (button == configureDeviceButton)
     {
         if (! thread->isThreadRunning())
@@ -633,24 +922,90 @@ void NIDAQEditor::buttonEvent (Button* button)
     }
 }
 
+void NIDAQEditor::showDeviceMenu()
+{
+    PopupMenu deviceMenu;
+
+    const int numAcquired = thread->getNumAcquiredDevices();
+    const int focused = thread->getFocusedDeviceIndex();
+
+    deviceMenu.addSectionHeader ("Acquiring from");
+
+    for (int i = 0; i < numAcquired; i++)
+    {
+        String deviceName = thread->getAcquiredDeviceName (i);
+        NIDAQDevice* device = nullptr;
+
+        for (auto& dev : thread->getDevices())
+        {
+            if (dev->getName() == deviceName)
+                device = dev;
+        }
+
+        deviceMenu.addItem (i + 1, (device != nullptr ? device->productName : deviceName) + " (" + deviceName + ")", true, i == focused);
+    }
+
+    Array<NIDAQDevice*> available;
+
+    for (auto& dev : thread->getDevices())
+    {
+        if (! thread->isDeviceAcquired (dev->getName()) && dev->getName() != "Simulated")
+            available.add (dev);
+    }
+
+    if (available.size() > 0)
+    {
+        deviceMenu.addSeparator();
+
+        for (int i = 0; i < available.size(); i++)
+            deviceMenu.addItem (100 + i, "Add " + available[i]->productName + " (" + available[i]->getName() + ")");
+    }
+
+    if (numAcquired > 1)
+    {
+        deviceMenu.addSeparator();
+        deviceMenu.addItem (1000, "Remove " + thread->getProductName() + " (" + thread->getDeviceName() + ")");
+    }
+
+    const int result = deviceMenu.show();
+
+    if (result == 0) //user clicked outside of popup window
+        return;
+
+    if (result == 1000)
+        thread->removeDevice (focused);
+    else if (result >= 100)
+        thread->addDevice (available[result - 100]->getName());
+    else
+        thread->setFocusedDevice (result - 1);
+
+    CoreServices::updateSignalChain (this);
+
+    draw();
+}
+
 void NIDAQEditor::saveCustomParametersToXml (XmlElement* xml)
 {
-    xml->setAttribute ("deviceName", thread->getDeviceName());
-    xml->setAttribute ("sampleRate", thread->getSampleRate());
-    xml->setAttribute ("voltageRange", thread->getVoltageRangeIndex());
+    /* The first device keeps the top-level attributes (as before multi-device support);
+       each further device is saved in its own child element */
+    saveDeviceParametersToXml (xml, thread->getAcquiredDevice (0));
 
-    xml->setAttribute ("numAnalog", thread->getNumActiveAnalogInputs());
-    xml->setAttribute ("numDigital", thread->getNumActiveDigitalInputs());
-    xml->setAttribute ("digitalReadSize", thread->getDigitalReadSize());
+    for (int i = 1; i < thread->getNumAcquiredDevices(); i++)
+        saveDeviceParametersToXml (xml->createNewChildElement ("DEVICE"), thread->getAcquiredDevice (i));
 
-    String digitalPortStates = "";
-    for (int i = 0; i < thread->getNumPorts(); i++)
-        digitalPortStates += thread->getPortState (i) ? "1" : "0";
-    xml->setAttribute ("digitalPortStates", digitalPortStates);
+    /* Settings shared by all devices, saved once */
+    xml->setAttribute ("traceAcquisition", thread->getTraceAcquisition() ? 1 : 0);
+    xml->setAttribute ("latencyHistograms", thread->getWriteLatencyHistograms() ? 1 : 0);
+    xml->setAttribute ("metricsPort", thread->getMetricsPort());
 }
 
 void NIDAQEditor::loadCustomParametersFromXml (XmlElement* xml)
 {
+    while (thread->getNumAcquiredDevices() > 1)
+        thread->removeDevice (thread->getNumAcquiredDevices() - 1);
+
+    thread->setFocusedDevice (0);
+
     String deviceToLoad = xml->getStringAttribute ("deviceName", "NIDAQmx");
 
     // Load device
@@ -665,23 +1020,78 @@ void NIDAQEditor::loadCustomParametersFromXml (XmlElement* xml)
         }
     }
 
-    float sampleRate = xml->getStringAttribute ("sampleRate", "0.0").getFloatValue();
+    loadDeviceParametersFromXml (xml);
 
-    // Load sample rate
-    if (sampleRate > 0.0f)
+    // Load settings shared by all devices
+    thread->setTraceAcquisition (xml->getStringAttribute ("traceAcquisition", "0").getIntValue() == 1);
+    thread->setWriteLatencyHistograms (xml->getStringAttribute ("latencyHistograms", "0").getIntValue() == 1);
+    thread->setMetricsPort (xml->getIntAttribute ("metricsPort", 0));
+
+    // Load additional devices
+    for (auto* deviceXml : xml->getChildWithTagNameIterator ("DEVICE"))
     {
-        int idx = 0;
-        for (auto& sr : thread->getSampleRates())
+        String deviceName = deviceXml->getStringAttribute ("deviceName");
+
+        if (thread->addDevice (deviceName) < 0)
         {
-            if (sr == sampleRate)
-            {
-                LOGD ("Setting saved sample rate: " + String (sampleRate) + " (" + String (idx) + ")");
-                thread->setSampleRate (idx);
-                sampleRateSelectBox->setSelectedItemIndex (thread->getSampleRateIndex(), false);
-                break;
-            }
-            idx++;
+            LOGC ("NIDAQ: saved device ", deviceName, " is not available");
+            continue;
         }
+
+        loadDeviceParametersFromXml (deviceXml);
+    }
+
+    thread->setFocusedDevice (0);
+
+    draw();
+}
+
+void NIDAQEditor::saveDeviceParametersToXml (XmlElement* xml, NIDAQmx* nidaq)
+{
+    xml->setAttribute ("deviceName", nidaq->device->getName());
+    xml->setAttribute ("sampleRate", nidaq->getRequestedSampleRate());
+    xml->setAttribute ("voltageRange", nidaq->getVoltageRangeIndex());
+
+    xml->setAttribute ("numAnalog", nidaq->getNumActiveAnalogInputs());
+    xml->setAttribute ("numDigital", nidaq->getNumActiveDigitalInputs());
+    xml->setAttribute ("digitalReadSize", nidaq->getDigitalReadSize());
+    xml->setAttribute ("rawSamples", nidaq->getUseRawSamples() ? 1 : 0);
+    xml->setAttribute ("callbacks", nidaq->getUseCallbacks() ? 1 : 0);
+    xml->setAttribute ("targetLatencyMs", nidaq->getTargetLatencyMs());
+    xml->setAttribute ("adaptiveReads", nidaq->getAdaptiveReads() ? 1 : 0);
+    xml->setAttribute ("bufferSeconds", nidaq->getBufferSeconds());
+    xml->setAttribute ("threadPriority", int (nidaq->getThreadPriority()));
+    xml->setAttribute ("cpuCore", nidaq->getCpuCore());
+    xml->setAttribute ("clockAnchors", nidaq->getWriteClockAnchors() ? 1 : 0);
+    xml->setAttribute ("decimationFactor", nidaq->getDecimationFactor());
+    xml->setAttribute ("decimationTaps", nidaq->getDecimationTaps());
+    xml->setAttribute ("highPassCutoff", nidaq->getHighPassCutoff());
+    xml->setAttribute ("notchFrequency", nidaq->getNotchFrequency());
+    xml->setAttribute ("lowLatency", nidaq->getLowLatency() ? 1 : 0);
+
+    String digitalPortStates = "";
+    for (int i = 0; i < nidaq->getNumPorts(); i++)
+        digitalPortStates += nidaq->getPortState (i) ? "1" : "0";
+    xml->setAttribute ("digitalPortStates", digitalPortStates);
+}
+
+void NIDAQEditor::loadDeviceParametersFromXml (XmlElement* xml)
+{
+    double sampleRate = xml->getDoubleAttribute ("sampleRate", 0.0);
+
+    // Load sample rate (a preset, or any rate within the device range)
+    if (sampleRate > 0.0)
+    {
+        int idx = thread->getSampleRates().indexOf (sampleRate);
+
+        LOGD ("Setting saved sample rate: " + String (sampleRate) + " (" + String (idx) + ")");
+
+        if (idx >= 0)
+            thread->setSampleRate (idx);
+        else
+            thread->setCustomSampleRate (sampleRate);
+
+        updateSampleRateText();
     }
 
     // Load voltage range
@@ -719,6 +1129,46 @@ void NIDAQEditor::loadCustomParametersFromXml (XmlElement* xml)
         thread->setDigitalReadSize (digitalReadSize);
     }
 
+    // Load sample format
+    thread->setUseRawSamples (xml->getStringAttribute ("rawSamples", "0").getIntValue() == 1);
+
+    // Load read mode
+    thread->setUseCallbacks (xml->getStringAttribute ("callbacks", "0").getIntValue() == 1);
+
+    // Load read latency
+    int targetLatencyMs = xml->getIntAttribute ("targetLatencyMs", DEFAULT_TARGET_LATENCY_MS);
+
+    if (targetLatencyMs > 0)
+        thread->setTargetLatencyMs (targetLatencyMs);
+
+    thread->setAdaptiveReads (xml->getStringAttribute ("adaptiveReads", "0").getIntValue() == 1);
+
+    // Load host buffer size
+    double bufferSeconds = xml->getDoubleAttribute ("bufferSeconds", DEFAULT_BUFFER_SECONDS);
+
+    if (bufferSeconds > 0)
+        thread->setBufferSeconds (bufferSeconds);
+
+    // Load acquisition thread scheduling
+    int threadPriority = xml->getIntAttribute ("threadPriority", PRIORITY_NORMAL);
+
+    if (threadPriority >= PRIORITY_NORMAL && threadPriority <= PRIORITY_REALTIME_FIFO)
+        thread->setThreadPriority (THREAD_PRIORITY (threadPriority));
+
+    thread->setCpuCore (jlimit (-1, SystemStats::getNumCpus() - 1, xml->getIntAttribute ("cpuCore", -1)));
+
+    thread->setWriteClockAnchors (xml->getStringAttribute ("clockAnchors", "0").getIntValue() == 1);
+
+    // Load decimated stream
+    thread->setDecimationFactor (xml->getIntAttribute ("decimationFactor", 1));
+    thread->setDecimationTaps (xml->getIntAttribute ("decimationTaps", DEFAULT_DECIMATION_TAPS));
+
+    // Load analog input conditioning
+    thread->setHighPassCutoff (xml->getDoubleAttribute ("highPassCutoff", 0));
+    thread->setNotchFrequency (xml->getDoubleAttribute ("notchFrequency", 0));
+
+    thread->setLowLatency (xml->getStringAttribute ("lowLatency", "0").getIntValue() == 1);
+
     String digitalPortStates = xml->getStringAttribute ("digitalPortStates", "000");
 
     for (int i = 0; i < digitalPortStates.length(); i++)
@@ -794,11 +1244,347 @@ PopupConfigurationWindow::PopupConfigurationWindow (NIDAQEditor* editor_)
         digitalPortButtons.add (button);
     }
 
-    setSize (180, 110);
+    sampleFormatLabel = new Label ("Sample Format", "Sample Format: ");
+    sampleFormatLabel->setColour (Label::textColourId, Colours::white);
+    sampleFormatLabel->setBounds (2, 110, 110, 20);
+    addAndMakeVisible (sampleFormatLabel);
+
+    sampleFormatSelect = new ComboBox ("Sample Format Selector");
+    sampleFormatSelect->addItem ("Scaled", 1);
+    sampleFormatSelect->addItem ("Raw", 2);
+    sampleFormatSelect->setSelectedId (editor->getUseRawSamples() ? 2 : 1, dontSendNotification);
+    sampleFormatSelect->setBounds (115, 110, 60, 20);
+    sampleFormatSelect->addListener (this);
+    addAndMakeVisible (sampleFormatSelect);
+
+    readModeLabel = new Label ("Read Mode", "Read Mode: ");
+    readModeLabel->setColour (Label::textColourId, Colours::white);
+    readModeLabel->setBounds (2, 135, 110, 20);
+    addAndMakeVisible (readModeLabel);
+
+    readModeSelect = new ComboBox ("Read Mode Selector");
+    readModeSelect->addItem ("Thread", 1);
+    readModeSelect->addItem ("Callback", 2);
+    readModeSelect->setSelectedId (editor->getUseCallbacks() ? 2 : 1, dontSendNotification);
+    readModeSelect->setBounds (115, 135, 60, 20);
+    readModeSelect->addListener (this);
+    addAndMakeVisible (readModeSelect);
+
+    latencyLabel = new Label ("Target Latency", "Target Latency: ");
+    latencyLabel->setColour (Label::textColourId, Colours::white);
+    latencyLabel->setBounds (2, 160, 110, 20);
+    addAndMakeVisible (latencyLabel);
+
+    latencySelect = new ComboBox ("Target Latency Selector");
+    Array<int> latencyOptions = { 1, 2, 5, 10, 20, 50, 100, 200, 500 };
+    for (int i = 0; i < latencyOptions.size(); i++)
+    {
+        // Only targets whose reads fit in the DataBuffer at the current sample rate
+        if (i > 0 && editor->getSampleRate() * latencyOptions[i] / 1000.0 > MAX_SAMPLES_PER_READ)
+            break;
+
+        latencySelect->addItem (String (latencyOptions[i]) + " ms", i + 1);
+        if (latencyOptions[i] == editor->getTargetLatencyMs())
+            latencySelect->setSelectedId (i + 1, dontSendNotification);
+    }
+    latencySelect->setBounds (115, 160, 60, 20);
+    latencySelect->addListener (this);
+    addAndMakeVisible (latencySelect);
+
+    adaptiveReadsLabel = new Label ("Adaptive Reads", "Adaptive Reads: ");
+    adaptiveReadsLabel->setColour (Label::textColourId, Colours::white);
+    adaptiveReadsLabel->setBounds (2, 185, 110, 20);
+    addAndMakeVisible (adaptiveReadsLabel);
+
+    adaptiveReadsSelect = new ComboBox ("Adaptive Reads Selector");
+    adaptiveReadsSelect->addItem ("Off", 1);
+    adaptiveReadsSelect->addItem ("On", 2);
+    adaptiveReadsSelect->setSelectedId (editor->getAdaptiveReads() ? 2 : 1, dontSendNotification);
+    adaptiveReadsSelect->setBounds (115, 185, 60, 20);
+    adaptiveReadsSelect->addListener (this);
+    addAndMakeVisible (adaptiveReadsSelect);
+
+    bufferSecondsLabel = new Label ("Buffer Slack", "Buffer Slack: ");
+    bufferSecondsLabel->setColour (Label::textColourId, Colours::white);
+    bufferSecondsLabel->setBounds (2, 210, 110, 20);
+    addAndMakeVisible (bufferSecondsLabel);
+
+    bufferSecondsSelect = new ComboBox ("Buffer Slack Selector");
+    Array<double> bufferOptions = { 0.5, 1, 2, 5, 10 };
+    for (int i = 0; i < bufferOptions.size(); i++)
+    {
+        bufferSecondsSelect->addItem (String (bufferOptions[i]) + " s", i + 1);
+        if (bufferOptions[i] == editor->getBufferSeconds())
+            bufferSecondsSelect->setSelectedId (i + 1, dontSendNotification);
+    }
+    bufferSecondsSelect->setBounds (115, 210, 60, 20);
+    bufferSecondsSelect->addListener (this);
+    addAndMakeVisible (bufferSecondsSelect);
+
+    threadPriorityLabel = new Label ("Priority", "Priority: ");
+    threadPriorityLabel->setColour (Label::textColourId, Colours::white);
+    threadPriorityLabel->setBounds (2, 235, 110, 20);
+    addAndMakeVisible (threadPriorityLabel);
+
+    threadPrioritySelect = new ComboBox ("Priority Selector");
+    threadPrioritySelect->addItem ("Normal", PRIORITY_NORMAL + 1);
+    threadPrioritySelect->addItem ("High", PRIORITY_HIGH + 1);
+    threadPrioritySelect->addItem ("RT (RR)", PRIORITY_REALTIME_RR + 1);
+    threadPrioritySelect->addItem ("RT (FIFO)", PRIORITY_REALTIME_FIFO + 1);
+    threadPrioritySelect->setSelectedId (editor->getThreadPriority() + 1, dontSendNotification);
+    threadPrioritySelect->setBounds (115, 235, 60, 20);
+    threadPrioritySelect->addListener (this);
+    addAndMakeVisible (threadPrioritySelect);
+
+    cpuCoreLabel = new Label ("CPU Core", "CPU Core: ");
+    cpuCoreLabel->setColour (Label::textColourId, Colours::white);
+    cpuCoreLabel->setBounds (2, 260, 110, 20);
+    addAndMakeVisible (cpuCoreLabel);
+
+    cpuCoreSelect = new ComboBox ("CPU Core Selector");
+    cpuCoreSelect->addItem ("Any", 1);
+    for (int core = 0; core < SystemStats::getNumCpus(); core++)
+        cpuCoreSelect->addItem (String (core), core + 2);
+    cpuCoreSelect->setSelectedId (editor->getCpuCore() + 2, dontSendNotification);
+    cpuCoreSelect->setBounds (115, 260, 60, 20);
+    cpuCoreSelect->addListener (this);
+    addAndMakeVisible (cpuCoreSelect);
+
+    clockAnchorsLabel = new Label ("Clock Anchors", "Clock Anchors: ");
+    clockAnchorsLabel->setColour (Label::textColourId, Colours::white);
+    clockAnchorsLabel->setBounds (2, 285, 110, 20);
+    addAndMakeVisible (clockAnchorsLabel);
+
+    clockAnchorsSelect = new ComboBox ("Clock Anchors Selector");
+    clockAnchorsSelect->addItem ("Off", 1);
+    clockAnchorsSelect->addItem ("On", 2);
+    clockAnchorsSelect->setSelectedId (editor->getWriteClockAnchors() ? 2 : 1, dontSendNotification);
+    clockAnchorsSelect->setBounds (115, 285, 60, 20);
+    clockAnchorsSelect->addListener (this);
+    addAndMakeVisible (clockAnchorsSelect);
+
+    decimationLabel = new Label ("Decimate", "Decimate: ");
+    decimationLabel->setColour (Label::textColourId, Colours::white);
+    decimationLabel->setBounds (2, 310, 110, 20);
+    addAndMakeVisible (decimationLabel);
+
+    decimationSelect = new ComboBox ("Decimate Selector");
+    decimationSelect->addItem ("Off", 1);
+    Array<int> decimationOptions = { 2, 4, 5, 10, 20, 30 };
+    for (int i = 0; i < decimationOptions.size(); i++)
+        decimationSelect->addItem (String (decimationOptions[i]) + "x", decimationOptions[i]);
+    decimationSelect->setSelectedId (editor->getDecimationFactor(), dontSendNotification);
+    decimationSelect->setBounds (115, 310, 60, 20);
+    decimationSelect->addListener (this);
+    addAndMakeVisible (decimationSelect);
+
+    decimationTapsLabel = new Label ("Filter Taps", "Filter Taps: ");
+    decimationTapsLabel->setColour (Label::textColourId, Colours::white);
+    decimationTapsLabel->setBounds (2, 335, 110, 20);
+    addAndMakeVisible (decimationTapsLabel);
+
+    decimationTapsSelect = new ComboBox ("Filter Taps Selector");
+    Array<int> tapOptions = { 16, 32, 64, 128, 256 };
+    for (int i = 0; i < tapOptions.size(); i++)
+        decimationTapsSelect->addItem (String (tapOptions[i]), tapOptions[i]);
+    decimationTapsSelect->setSelectedId (editor->getDecimationTaps(), dontSendNotification);
+    decimationTapsSelect->setBounds (115, 335, 60, 20);
+    decimationTapsSelect->addListener (this);
+    addAndMakeVisible (decimationTapsSelect);
+
+    highPassLabel = new Label ("High-pass", "High-pass: ");
+    highPassLabel->setColour (Label::textColourId, Colours::white);
+    highPassLabel->setBounds (2, 360, 110, 20);
+    addAndMakeVisible (highPassLabel);
+
+    highPassSelect = new ComboBox ("High-pass Selector");
+    highPassSelect->addItem ("Off", 1);
+    Array<double> highPassOptions = { 0.1, 0.3, 1, 3, 10, 100, 300 };
+    for (int i = 0; i < highPassOptions.size(); i++)
+    {
+        highPassSelect->addItem (String (highPassOptions[i]) + " Hz", i + 2);
+        if (highPassOptions[i] == editor->getHighPassCutoff())
+            highPassSelect->setSelectedId (i + 2, dontSendNotification);
+    }
+    if (editor->getHighPassCutoff() == 0)
+        highPassSelect->setSelectedId (1, dontSendNotification);
+    highPassSelect->setBounds (115, 360, 60, 20);
+    highPassSelect->addListener (this);
+    addAndMakeVisible (highPassSelect);
+
+    notchLabel = new Label ("Notch", "Notch: ");
+    notchLabel->setColour (Label::textColourId, Colours::white);
+    notchLabel->setBounds (2, 385, 110, 20);
+    addAndMakeVisible (notchLabel);
+
+    notchSelect = new ComboBox ("Notch Selector");
+    notchSelect->addItem ("Off", 1);
+    notchSelect->addItem ("50 Hz", 50);
+    notchSelect->addItem ("60 Hz", 60);
+    notchSelect->setSelectedId (editor->getNotchFrequency() > 0 ? int (editor->getNotchFrequency()) : 1, dontSendNotification);
+    notchSelect->setBounds (115, 385, 60, 20);
+    notchSelect->addListener (this);
+    addAndMakeVisible (notchSelect);
+
+    lowLatencyLabel = new Label ("Low Latency", "Low Latency: ");
+    lowLatencyLabel->setColour (Label::textColourId, Colours::white);
+    lowLatencyLabel->setBounds (2, 410, 110, 20);
+    addAndMakeVisible (lowLatencyLabel);
+
+    lowLatencySelect = new ComboBox ("Low Latency Selector");
+    lowLatencySelect->addItem ("Off", 1);
+    lowLatencySelect->addItem ("On", 2);
+    lowLatencySelect->setSelectedId (editor->getLowLatency() ? 2 : 1, dontSendNotification);
+    lowLatencySelect->setBounds (115, 410, 60, 20);
+    lowLatencySelect->addListener (this);
+    addAndMakeVisible (lowLatencySelect);
+
+    traceLabel = new Label ("Trace", "Trace: ");
+    traceLabel->setColour (Label::textColourId, Colours::white);
+    traceLabel->setBounds (2, 435, 110, 20);
+    addAndMakeVisible (traceLabel);
+
+    traceSelect = new ComboBox ("Trace Selector");
+    traceSelect->addItem ("Off", 1);
+    traceSelect->addItem ("On", 2);
+    traceSelect->setSelectedId (editor->getTraceAcquisition() ? 2 : 1, dontSendNotification);
+    traceSelect->setTooltip ("Write a Chrome/Perfetto trace of each read and block to the recording directory when acquisition stops");
+    traceSelect->setBounds (115, 435, 60, 20);
+    traceSelect->addListener (this);
+    addAndMakeVisible (traceSelect);
+
+    histogramsLabel = new Label ("Latency CSV", "Latency CSV: ");
+    histogramsLabel->setColour (Label::textColourId, Colours::white);
+    histogramsLabel->setBounds (2, 460, 110, 20);
+    addAndMakeVisible (histogramsLabel);
+
+    histogramsSelect = new ComboBox ("Latency CSV Selector");
+    histogramsSelect->addItem ("Off", 1);
+    histogramsSelect->addItem ("On", 2);
+    histogramsSelect->setSelectedId (editor->getWriteLatencyHistograms() ? 2 : 1, dontSendNotification);
+    histogramsSelect->setTooltip ("Write the read, processing and read interval histograms to the recording directory when acquisition stops");
+    histogramsSelect->setBounds (115, 460, 60, 20);
+    histogramsSelect->addListener (this);
+    addAndMakeVisible (histogramsSelect);
+
+    metricsLabel = new Label ("Metrics", "Metrics: ");
+    metricsLabel->setColour (Label::textColourId, Colours::white);
+    metricsLabel->setBounds (2, 485, 110, 20);
+    addAndMakeVisible (metricsLabel);
+
+    metricsSelect = new ComboBox ("Metrics Selector");
+    metricsSelect->addItem ("Off", 1);
+    metricsSelect->addItem ("On", 2);
+    metricsSelect->setSelectedId (editor->getMetricsPort() > 0 ? 2 : 1, dontSendNotification);
+    metricsSelect->setTooltip ("Serve Prometheus metrics for all devices at http://127.0.0.1:" + String (DEFAULT_METRICS_PORT) + "/metrics");
+    metricsSelect->setBounds (115, 485, 60, 20);
+    metricsSelect->addListener (this);
+    addAndMakeVisible (metricsSelect);
+
+    setSize (180, 510);
 }
 
 void PopupConfigurationWindow::comboBoxChanged (ComboBox* comboBox)
 {
+    if (comboBox == sampleFormatSelect)
+    {
+        editor->setUseRawSamples (sampleFormatSelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == readModeSelect)
+    {
+        editor->setUseCallbacks (readModeSelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == latencySelect)
+    {
+        editor->setTargetLatencyMs (latencySelect->getText().getIntValue());
+        return;
+    }
+
+    if (comboBox == adaptiveReadsSelect)
+    {
+        editor->setAdaptiveReads (adaptiveReadsSelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == bufferSecondsSelect)
+    {
+        editor->setBufferSeconds (bufferSecondsSelect->getText().getDoubleValue());
+        return;
+    }
+
+    if (comboBox == threadPrioritySelect)
+    {
+        editor->setThreadPriority (THREAD_PRIORITY (threadPrioritySelect->getSelectedId() - 1));
+        return;
+    }
+
+    if (comboBox == cpuCoreSelect)
+    {
+        editor->setCpuCore (cpuCoreSelect->getSelectedId() - 2);
+        return;
+    }
+
+    if (comboBox == clockAnchorsSelect)
+    {
+        editor->setWriteClockAnchors (clockAnchorsSelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == decimationSelect)
+    {
+        editor->setDecimationFactor (decimationSelect->getSelectedId());
+        return;
+    }
+
+    if (comboBox == decimationTapsSelect)
+    {
+        editor->setDecimationTaps (decimationTapsSelect->getSelectedId());
+        return;
+    }
+
+    if (comboBox == highPassSelect)
+    {
+        editor->setHighPassCutoff (highPassSelect->getSelectedId() == 1 ? 0 : highPassSelect->getText().getDoubleValue());
+        return;
+    }
+
+    if (comboBox == lowLatencySelect)
+    {
+        editor->setLowLatency (lowLatencySelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == traceSelect)
+    {
+        editor->setTraceAcquisition (traceSelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == histogramsSelect)
+    {
+        editor->setWriteLatencyHistograms (histogramsSelect->getSelectedId() == 2);
+        return;
+    }
+
+    if (comboBox == metricsSelect)
+    {
+        /* Back to Off if the port is taken */
+        if (! editor->setMetricsPort (metricsSelect->getSelectedId() == 2 ? DEFAULT_METRICS_PORT : 0))
+            metricsSelect->setSelectedId (1, dontSendNotification);
+
+        return;
+    }
+
+    if (comboBox == notchSelect)
+    {
+        editor->setNotchFrequency (notchSelect->getSelectedId() == 1 ? 0 : notchSelect->getSelectedId());
+        return;
+    }
+
     int numAnalogInputs = int (analogChannelCountSelect->getItemText (analogChannelCountSelect->getSelectedId() - 1).getFloatValue());
     int numDigitalInputs = int (digitalChannelCountSelect->getItemText (digitalChannelCountSelect->getSelectedId() - 1).getFloatValue());
     int digitalRead = int (digitalReadSelect->getItemText (digitalReadSelect->getSelectedId() - 1).getFloatValue());
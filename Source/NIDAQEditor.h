@@ -28,6 +28,11 @@
 #include <EditorHeaders.h>
 #include <ProcessorHeaders.h>
 
+#define FIFO_MONITOR_INTERVAL_MS 100
+#define FIFO_PEAK_HOLD_MS 2000
+#define FIFO_WARNING_FILL 0.5f // buffer fraction at which the monitor turns orange
+#define AI_CHANNELS_PER_PAGE 32 // analog inputs shown at once; larger devices page through them
+
 class UtilityButton;
 /**
 
@@ -47,12 +52,15 @@ class ColorSelector;
 class EditorBackground : public Component
 {
 public:
-    EditorBackground (int nAI, int nDI);
+    /* nAI inputs shown, starting at firstAI, out of totalAI */
+    EditorBackground (int nAI, int nDI, int firstAI, int totalAI);
 
 private:
     void paint (Graphics& g);
     int nAI;
     int nDI;
+    int firstAI;
+    int totalAI;
 };
 
 class AIButton : public ToggleButton, public Timer
@@ -95,6 +103,10 @@ private:
 
     int id;
     bool enabled;
+
+    /* Lights up when the line toggled since the last timer tick */
+    uint32 lastEdgeCount = 0;
+    bool active = false;
 };
 
 class SourceTypeButton : public TextButton, public Timer
@@ -118,21 +130,49 @@ private:
     bool enabled;
 };
 
-class FifoMonitor : public Component, public Timer
+/* Fill level of the DAQmx host buffer (top bar) and of the DataBuffer feeding the GUI (bottom bar),
+   with a held peak marker; turns orange once either peak passes FIFO_WARNING_FILL */
+class FifoMonitor : public Component, public SettableTooltipClient, public Timer
 {
 public:
     FifoMonitor (NIDAQThread* thread);
 
-    void setFillPercentage (float percentage);
+    void timerCallback();
+
+private:
+    void paint (Graphics& g);
+    void paintBar (Graphics& g, int y, int height, float fill, float peak);
+
+    /* Holds the highest fill seen for a while, then follows the level down */
+    struct PeakHold
+    {
+        float peak = 0.0f;
+        int ticksLeft = 0;
+
+        void update (float fill);
+    };
+
+    NIDAQThread* thread;
+
+    float hostFill = 0.0f;
+    float dataFill = 0.0f;
+    PeakHold hostPeak;
+    PeakHold dataPeak;
+};
+
+class LatencyMonitor : public Component, public SettableTooltipClient, public Timer
+{
+public:
+    LatencyMonitor (NIDAQThread* thread);
 
     void timerCallback();
 
 private:
     void paint (Graphics& g);
 
-    float fillPercentage;
     NIDAQThread* thread;
-    int id;
+    String text;
+    bool late = false;
 };
 
 class BackgroundLoader : public Thread
@@ -173,6 +213,54 @@ private:
     ScopedPointer<Label> digitalReadLabel;
     ScopedPointer<ComboBox> digitalReadSelect;
 
+    ScopedPointer<Label> sampleFormatLabel;
+    ScopedPointer<ComboBox> sampleFormatSelect;
+
+    ScopedPointer<Label> readModeLabel;
+    ScopedPointer<ComboBox> readModeSelect;
+
+    ScopedPointer<Label> latencyLabel;
+    ScopedPointer<ComboBox> latencySelect;
+
+    ScopedPointer<Label> adaptiveReadsLabel;
+    ScopedPointer<ComboBox> adaptiveReadsSelect;
+
+    ScopedPointer<Label> bufferSecondsLabel;
+    ScopedPointer<ComboBox> bufferSecondsSelect;
+
+    ScopedPointer<Label> threadPriorityLabel;
+    ScopedPointer<ComboBox> threadPrioritySelect;
+
+    ScopedPointer<Label> cpuCoreLabel;
+    ScopedPointer<ComboBox> cpuCoreSelect;
+
+    ScopedPointer<Label> clockAnchorsLabel;
+    ScopedPointer<ComboBox> clockAnchorsSelect;
+
+    ScopedPointer<Label> decimationLabel;
+    ScopedPointer<ComboBox> decimationSelect;
+
+    ScopedPointer<Label> decimationTapsLabel;
+    ScopedPointer<ComboBox> decimationTapsSelect;
+
+    ScopedPointer<Label> highPassLabel;
+    ScopedPointer<ComboBox> highPassSelect;
+
+    ScopedPointer<Label> notchLabel;
+    ScopedPointer<ComboBox> notchSelect;
+
+    ScopedPointer<Label> lowLatencyLabel;
+    ScopedPointer<ComboBox> lowLatencySelect;
+
+    ScopedPointer<Label> traceLabel;
+    ScopedPointer<ComboBox> traceSelect;
+
+    ScopedPointer<Label> histogramsLabel;
+    ScopedPointer<ComboBox> histogramsSelect;
+
+    ScopedPointer<Label> metricsLabel;
+    ScopedPointer<ComboBox> metricsSelect;
+
     OwnedArray<ToggleButton> digitalPortButtons;
 };
 
@@ -190,6 +278,9 @@ public:
     void update (int analogCount, int digitalCount, int digitalRead);
 
     void buttonEvent (Button* button);
+
+    /* Shows the rate the sample clock really runs at, which may differ from the one requested */
+    void updateSampleRateText();
     void comboBoxChanged (ComboBox*);
 
     /** Respond to button presses */
@@ -201,6 +292,13 @@ public:
     void saveCustomParametersToXml (XmlElement*) override;
     void loadCustomParametersFromXml (XmlElement*) override;
 
+    /* Settings of one device (loading applies them to the focused one) */
+    void saveDeviceParametersToXml (XmlElement*, NIDAQmx*);
+    void loadDeviceParametersFromXml (XmlElement*);
+
+    /* Lets the user add, remove or focus the devices acquired in parallel */
+    void showDeviceMenu();
+
     int getTotalAvailableAnalogInputs() { return thread->getTotalAvailableAnalogInputs(); };
     int getTotalAvailableDigitalInputs() { return thread->getTotalAvailableDigitalInputs(); };
 
@@ -209,6 +307,52 @@ public:
 
     int getDigitalReadSize() { return thread->getDigitalReadSize(); };
 
+    bool getUseRawSamples() { return thread->getUseRawSamples(); };
+    void setUseRawSamples (bool useRawSamples);
+
+    bool getUseCallbacks() { return thread->getUseCallbacks(); };
+    void setUseCallbacks (bool useCallbacks) { thread->setUseCallbacks (useCallbacks); };
+
+    float getSampleRate() { return thread->getSampleRate(); };
+
+    int getTargetLatencyMs() { return thread->getTargetLatencyMs(); };
+    void setTargetLatencyMs (int targetLatencyMs) { thread->setTargetLatencyMs (targetLatencyMs); };
+    bool getAdaptiveReads() { return thread->getAdaptiveReads(); };
+    void setAdaptiveReads (bool adaptiveReads) { thread->setAdaptiveReads (adaptiveReads); };
+
+    double getBufferSeconds() { return thread->getBufferSeconds(); };
+    void setBufferSeconds (double bufferSeconds) { thread->setBufferSeconds (bufferSeconds); };
+
+    THREAD_PRIORITY getThreadPriority() { return thread->getThreadPriority(); };
+    void setThreadPriority (THREAD_PRIORITY threadPriority) { thread->setThreadPriority (threadPriority); };
+    int getCpuCore() { return thread->getCpuCore(); };
+    void setCpuCore (int cpuCore) { thread->setCpuCore (cpuCore); };
+
+    bool getWriteClockAnchors() { return thread->getWriteClockAnchors(); };
+    void setWriteClockAnchors (bool writeClockAnchors) { thread->setWriteClockAnchors (writeClockAnchors); };
+
+    int getDecimationFactor() { return thread->getDecimationFactor(); };
+    void setDecimationFactor (int factor);
+    int getDecimationTaps() { return thread->getDecimationTaps(); };
+    void setDecimationTaps (int taps) { thread->setDecimationTaps (taps); };
+
+    double getHighPassCutoff() { return thread->getHighPassCutoff(); };
+    void setHighPassCutoff (double cutoff);
+    double getNotchFrequency() { return thread->getNotchFrequency(); };
+    void setNotchFrequency (double frequency);
+
+    bool getLowLatency() { return thread->getLowLatency(); };
+    void setLowLatency (bool lowLatency) { thread->setLowLatency (lowLatency); };
+
+    bool getTraceAcquisition() { return thread->getTraceAcquisition(); };
+    void setTraceAcquisition (bool traceAcquisition) { thread->setTraceAcquisition (traceAcquisition); };
+
+    bool getWriteLatencyHistograms() { return thread->getWriteLatencyHistograms(); };
+    void setWriteLatencyHistograms (bool writeLatencyHistograms) { thread->setWriteLatencyHistograms (writeLatencyHistograms); };
+
+    int getMetricsPort() { return thread->getMetricsPort(); };
+    bool setMetricsPort (int port) { return thread->setMetricsPort (port); };
+
     int getNumPorts() { return thread->getNumPorts(); };
     bool getPortState (int idx) { return thread->getPortState (idx); };
     void setPortState (int idx, bool state) { thread->setPortState (idx, state); };
@@ -222,8 +366,15 @@ private:
     ScopedPointer<ComboBox> sampleRateSelectBox;
     ScopedPointer<ComboBox> voltageRangeSelectBox;
     ScopedPointer<FifoMonitor> fifoMonitor;
+    ScopedPointer<LatencyMonitor> latencyMonitor;
 
     ScopedPointer<UtilityButton> configureDeviceButton;
+    ScopedPointer<UtilityButton> deviceListButton;
+
+    /* Page of AI_CHANNELS_PER_PAGE analog inputs shown, for devices with more */
+    int aiPage = 0;
+    ScopedPointer<UtilityButton> prevAIPageButton;
+    ScopedPointer<UtilityButton> nextAIPageButton;
 
     Array<File> savingDirectories;
 
@@ -0,0 +1,1321 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NIDAQKernels.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NIDAQ_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define NIDAQ_X86 0
+#endif
+
+/* GCC and Clang only emit vector instructions inside functions that are built for them;
+   MSVC accepts the intrinsics anywhere. */
+#if defined(__GNUC__) || defined(__clang__)
+#define NIDAQ_TARGET(isa) __attribute__ ((target (isa)))
+#else
+#define NIDAQ_TARGET(isa)
+#endif
+
+/* Number of scans each per-channel pattern is repeated over (the widest vector holds 16 floats) */
+#define PATTERN_SCANS 16
+
+/*********************************************/
+// CPU feature detection
+/*********************************************/
+
+#if NIDAQ_X86
+
+static void cpuid (int leaf, int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex (info, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+        regs[i] = (unsigned int) info[i];
+#else
+    __cpuid_count (leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+/* Register state the OS saves on context switch (XCR0) */
+static uint64_t getEnabledXSaveFeatures()
+{
+#ifdef _MSC_VER
+    return _xgetbv (0);
+#else
+    unsigned int lo, hi;
+    __asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t) hi << 32) | lo;
+#endif
+}
+
+static SIMD_LEVEL detectSIMDLevel()
+{
+    unsigned int regs[4];
+
+    cpuid (0, 0, regs);
+    const unsigned int maxLeaf = regs[0];
+
+    cpuid (1, 0, regs);
+    const bool sse2 = (regs[3] & (1u << 26)) != 0;
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+
+    if (! sse2)
+        return SIMD_SCALAR;
+
+    if (! osxsave || ! avx || maxLeaf < 7)
+        return SIMD_SSE2;
+
+    const uint64_t xcr0 = getEnabledXSaveFeatures();
+    const bool ymmState = (xcr0 & 0x06) == 0x06;
+    const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+    cpuid (7, 0, regs);
+    const bool avx2 = (regs[1] & (1u << 5)) != 0;
+    const bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+    if (avx512f && zmmState)
+        return SIMD_AVX512;
+
+    if (avx2 && ymmState)
+        return SIMD_AVX2;
+
+    return SIMD_SSE2;
+}
+
+#else
+
+static SIMD_LEVEL detectSIMDLevel()
+{
+    return SIMD_SCALAR;
+}
+
+#endif
+
+SIMD_LEVEL getSupportedSIMDLevel()
+{
+    static const SIMD_LEVEL level = detectSIMDLevel();
+    return level;
+}
+
+const char* getSIMDLevelName (SIMD_LEVEL level)
+{
+    switch (level)
+    {
+        case SIMD_SSE2:
+            return "SSE2";
+        case SIMD_AVX2:
+            return "AVX2";
+        case SIMD_AVX512:
+            return "AVX-512";
+        default:
+            return "scalar";
+    }
+}
+
+/*********************************************/
+// Scalar reference
+/*********************************************/
+
+static inline float applyMask (float value, uint32_t mask)
+{
+    uint32_t bits;
+    memcpy (&bits, &value, sizeof (bits));
+    bits &= mask;
+    memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+/* Pattern index q advances with the output index and wraps at the pattern period */
+static void convertF64Scalar (const double* in, float* out, int count, const uint32_t* mask, int period, int q)
+{
+    for (int i = 0; i < count; i++)
+    {
+        out[i] = applyMask (float (in[i]), mask[q]);
+
+        if (++q == period)
+            q = 0;
+    }
+}
+
+static void convertI16Scalar (const int16_t* in, float* out, int count, const uint32_t* mask, const float* const* k, int numCoeffs, int period, int q)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const float x = float (in[i]);
+
+        float acc = k[numCoeffs - 1][q];
+        for (int n = numCoeffs - 2; n >= 0; n--)
+            acc = acc * x + k[n][q];
+
+        out[i] = applyMask (acc, mask[q]);
+
+        if (++q == period)
+            q = 0;
+    }
+}
+
+#if NIDAQ_X86
+
+/*********************************************/
+// SSE2 (4 samples per vector)
+/*********************************************/
+
+NIDAQ_TARGET ("sse2")
+static inline __m128 evaluateSSE2 (__m128 x, const uint32_t* mask, const float* const* k, int numCoeffs, int q)
+{
+    __m128 acc = _mm_loadu_ps (k[numCoeffs - 1] + q);
+    for (int n = numCoeffs - 2; n >= 0; n--)
+        acc = _mm_add_ps (_mm_mul_ps (acc, x), _mm_loadu_ps (k[n] + q));
+
+    return _mm_and_ps (acc, _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*) (mask + q))));
+}
+
+NIDAQ_TARGET ("sse2")
+static void convertF64SSE2 (const double* in, float* out, int count, const uint32_t* mask, int period)
+{
+    int i = 0;
+    int q = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 lo = _mm_cvtpd_ps (_mm_loadu_pd (in + i));
+        __m128 hi = _mm_cvtpd_ps (_mm_loadu_pd (in + i + 2));
+        __m128 m = _mm_castsi128_ps (_mm_loadu_si128 ((const __m128i*) (mask + q)));
+
+        _mm_storeu_ps (out + i, _mm_and_ps (_mm_movelh_ps (lo, hi), m));
+
+        if ((q += 4) == period)
+            q = 0;
+    }
+
+    convertF64Scalar (in + i, out + i, count - i, mask, period, q);
+}
+
+NIDAQ_TARGET ("sse2")
+static void convertI16SSE2 (const int16_t* in, float* out, int count, const uint32_t* mask, const float* const* k, int numCoeffs, int period)
+{
+    int i = 0;
+    int q = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i raw = _mm_loadu_si128 ((const __m128i*) (in + i));
+
+        /* Sign-extend by placing each value in the upper half of a 32-bit lane */
+        __m128 x0 = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (raw, raw), 16));
+        __m128 x1 = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpackhi_epi16 (raw, raw), 16));
+
+        _mm_storeu_ps (out + i, evaluateSSE2 (x0, mask, k, numCoeffs, q));
+
+        if ((q += 4) == period)
+            q = 0;
+
+        _mm_storeu_ps (out + i + 4, evaluateSSE2 (x1, mask, k, numCoeffs, q));
+
+        if ((q += 4) == period)
+            q = 0;
+    }
+
+    convertI16Scalar (in + i, out + i, count - i, mask, k, numCoeffs, period, q);
+}
+
+/*********************************************/
+// AVX2 (8 samples per vector)
+/*********************************************/
+
+NIDAQ_TARGET ("avx2")
+static void convertF64AVX2 (const double* in, float* out, int count, const uint32_t* mask, int period)
+{
+    int i = 0;
+    int q = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 lo = _mm256_cvtpd_ps (_mm256_loadu_pd (in + i));
+        __m128 hi = _mm256_cvtpd_ps (_mm256_loadu_pd (in + i + 4));
+        __m256 v = _mm256_insertf128_ps (_mm256_castps128_ps256 (lo), hi, 1);
+        __m256 m = _mm256_castsi256_ps (_mm256_loadu_si256 ((const __m256i*) (mask + q)));
+
+        _mm256_storeu_ps (out + i, _mm256_and_ps (v, m));
+
+        if ((q += 8) == period)
+            q = 0;
+    }
+
+    convertF64Scalar (in + i, out + i, count - i, mask, period, q);
+}
+
+NIDAQ_TARGET ("avx2")
+static void convertI16AVX2 (const int16_t* in, float* out, int count, const uint32_t* mask, const float* const* k, int numCoeffs, int period)
+{
+    int i = 0;
+    int q = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_cvtepi32_ps (_mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i*) (in + i))));
+
+        __m256 acc = _mm256_loadu_ps (k[numCoeffs - 1] + q);
+        for (int n = numCoeffs - 2; n >= 0; n--)
+            acc = _mm256_add_ps (_mm256_mul_ps (acc, x), _mm256_loadu_ps (k[n] + q));
+
+        __m256 m = _mm256_castsi256_ps (_mm256_loadu_si256 ((const __m256i*) (mask + q)));
+        _mm256_storeu_ps (out + i, _mm256_and_ps (acc, m));
+
+        if ((q += 8) == period)
+            q = 0;
+    }
+
+    convertI16Scalar (in + i, out + i, count - i, mask, k, numCoeffs, period, q);
+}
+
+/*********************************************/
+// AVX-512F (16 samples per vector)
+/*********************************************/
+
+NIDAQ_TARGET ("avx512f")
+static void convertF64AVX512 (const double* in, float* out, int count, const uint32_t* mask, int period)
+{
+    int i = 0;
+    int q = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 lo = _mm512_cvtpd_ps (_mm512_loadu_pd (in + i));
+        __m256 hi = _mm512_cvtpd_ps (_mm512_loadu_pd (in + i + 8));
+        __m512i v = _mm512_castpd_si512 (_mm512_insertf64x4 (_mm512_castpd256_pd512 (_mm256_castps_pd (lo)), _mm256_castps_pd (hi), 1));
+        __m512i m = _mm512_loadu_si512 ((const void*) (mask + q));
+
+        _mm512_storeu_ps (out + i, _mm512_castsi512_ps (_mm512_and_si512 (v, m)));
+
+        if ((q += 16) == period)
+            q = 0;
+    }
+
+    convertF64Scalar (in + i, out + i, count - i, mask, period, q);
+}
+
+NIDAQ_TARGET ("avx512f")
+static void convertI16AVX512 (const int16_t* in, float* out, int count, const uint32_t* mask, const float* const* k, int numCoeffs, int period)
+{
+    int i = 0;
+    int q = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 x = _mm512_cvtepi32_ps (_mm512_cvtepi16_epi32 (_mm256_loadu_si256 ((const __m256i*) (in + i))));
+
+        __m512 acc = _mm512_loadu_ps (k[numCoeffs - 1] + q);
+        for (int n = numCoeffs - 2; n >= 0; n--)
+            acc = _mm512_add_ps (_mm512_mul_ps (acc, x), _mm512_loadu_ps (k[n] + q));
+
+        __m512i m = _mm512_loadu_si512 ((const void*) (mask + q));
+        _mm512_storeu_ps (out + i, _mm512_castsi512_ps (_mm512_and_si512 (_mm512_castps_si512 (acc), m)));
+
+        if ((q += 16) == period)
+            q = 0;
+    }
+
+    convertI16Scalar (in + i, out + i, count - i, mask, k, numCoeffs, period, q);
+}
+
+#endif
+
+/*********************************************/
+// Transition detection
+/*********************************************/
+
+/* Compares each masked word with the one before it, from sample start onwards */
+static int detectTransitionsScalar (const uint32_t* codes, int start, int numSamples, uint32_t mask, uint32_t previous, int* indices, uint32_t* words, int count)
+{
+    for (int i = start; i < numSamples; i++)
+    {
+        const uint32_t code = codes[i] & mask;
+
+        if (code != previous)
+        {
+            indices[count] = i;
+            words[count] = code;
+            count++;
+        }
+
+        previous = code;
+    }
+
+    return count;
+}
+
+#if NIDAQ_X86
+
+/* The vector loops compare codes[i..] with codes[i-1..]; sample 0 is compared with the
+   previous block by the scalar path. Each bit of "changed" marks one sample. */
+
+NIDAQ_TARGET ("sse2")
+static int detectTransitionsSSE2 (const uint32_t* codes, int numSamples, uint32_t mask, uint32_t previous, int* indices, uint32_t* words)
+{
+    int count = detectTransitionsScalar (codes, 0, 1, mask, previous, indices, words, 0);
+    const __m128i m = _mm_set1_epi32 ((int) mask);
+
+    int i = 1;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m128i cur = _mm_and_si128 (_mm_loadu_si128 ((const __m128i*) (codes + i)), m);
+        __m128i prev = _mm_and_si128 (_mm_loadu_si128 ((const __m128i*) (codes + i - 1)), m);
+        unsigned int changed = ~(unsigned int) _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (cur, prev))) & 0xf;
+
+        for (; changed != 0; changed &= changed - 1)
+        {
+            const int index = i + findLowestSetBit (changed);
+            indices[count] = index;
+            words[count] = codes[index] & mask;
+            count++;
+        }
+    }
+
+    return detectTransitionsScalar (codes, i, numSamples, mask, codes[i - 1] & mask, indices, words, count);
+}
+
+NIDAQ_TARGET ("avx2")
+static int detectTransitionsAVX2 (const uint32_t* codes, int numSamples, uint32_t mask, uint32_t previous, int* indices, uint32_t* words)
+{
+    int count = detectTransitionsScalar (codes, 0, 1, mask, previous, indices, words, 0);
+    const __m256i m = _mm256_set1_epi32 ((int) mask);
+
+    int i = 1;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m256i cur = _mm256_and_si256 (_mm256_loadu_si256 ((const __m256i*) (codes + i)), m);
+        __m256i prev = _mm256_and_si256 (_mm256_loadu_si256 ((const __m256i*) (codes + i - 1)), m);
+        unsigned int changed = ~(unsigned int) _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (cur, prev))) & 0xff;
+
+        for (; changed != 0; changed &= changed - 1)
+        {
+            const int index = i + findLowestSetBit (changed);
+            indices[count] = index;
+            words[count] = codes[index] & mask;
+            count++;
+        }
+    }
+
+    return detectTransitionsScalar (codes, i, numSamples, mask, codes[i - 1] & mask, indices, words, count);
+}
+
+NIDAQ_TARGET ("avx512f")
+static int detectTransitionsAVX512 (const uint32_t* codes, int numSamples, uint32_t mask, uint32_t previous, int* indices, uint32_t* words)
+{
+    int count = detectTransitionsScalar (codes, 0, 1, mask, previous, indices, words, 0);
+    const __m512i m = _mm512_set1_epi32 ((int) mask);
+
+    int i = 1;
+    for (; i + 16 <= numSamples; i += 16)
+    {
+        __m512i cur = _mm512_and_si512 (_mm512_loadu_si512 ((const void*) (codes + i)), m);
+        __m512i prev = _mm512_and_si512 (_mm512_loadu_si512 ((const void*) (codes + i - 1)), m);
+        unsigned int changed = (unsigned int) _mm512_cmpneq_epi32_mask (cur, prev);
+
+        for (; changed != 0; changed &= changed - 1)
+        {
+            const int index = i + findLowestSetBit (changed);
+            indices[count] = index;
+            words[count] = codes[index] & mask;
+            count++;
+        }
+    }
+
+    return detectTransitionsScalar (codes, i, numSamples, mask, codes[i - 1] & mask, indices, words, count);
+}
+
+#endif
+
+TransitionDetector::TransitionDetector() : simdLevel (getSupportedSIMDLevel())
+{
+}
+
+void TransitionDetector::setSIMDLevel (SIMD_LEVEL level)
+{
+    simdLevel = level < getSupportedSIMDLevel() ? level : getSupportedSIMDLevel();
+}
+
+int TransitionDetector::detect (const uint32_t* codes, int numSamples, uint32_t mask, uint32_t previous, int* indices, uint32_t* words) const
+{
+    if (numSamples <= 0)
+        return 0;
+
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            return detectTransitionsAVX512 (codes, numSamples, mask, previous, indices, words);
+        case SIMD_AVX2:
+            return detectTransitionsAVX2 (codes, numSamples, mask, previous, indices, words);
+        case SIMD_SSE2:
+            return detectTransitionsSSE2 (codes, numSamples, mask, previous, indices, words);
+#endif
+        default:
+            return detectTransitionsScalar (codes, 0, numSamples, mask, previous, indices, words, 0);
+    }
+}
+
+/*********************************************/
+// Port packing
+/*********************************************/
+
+static void packPortsScalar (const uint32_t* scans, uint32_t* out, int start, int numScans, int numPorts, const int* shifts)
+{
+    for (int i = start; i < numScans; i++)
+    {
+        const uint32_t* scan = scans + i * numPorts;
+        uint32_t word = 0;
+
+        for (int p = 0; p < numPorts; p++)
+        {
+            if (shifts[p] < 32)
+                word |= scan[p] << shifts[p];
+        }
+
+        out[i] = word;
+    }
+}
+
+#if NIDAQ_X86
+
+/* Ports are strided by numPorts within the scans, so each one is gathered across a
+   vector of scans; a shift count of 32 or more clears the lanes, as the scalar path does */
+
+NIDAQ_TARGET ("avx2")
+static void packPortsAVX2 (const uint32_t* scans, uint32_t* out, int numScans, int numPorts, const int* shifts)
+{
+    const __m256i scanOffsets = _mm256_mullo_epi32 (_mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32 (numPorts));
+
+    int i = 0;
+    for (; i + 8 <= numScans; i += 8)
+    {
+        const int* base = (const int*) (scans + i * numPorts);
+        __m256i word = _mm256_setzero_si256();
+
+        for (int p = 0; p < numPorts; p++)
+        {
+            __m256i port = _mm256_i32gather_epi32 (base + p, scanOffsets, 4);
+            word = _mm256_or_si256 (word, _mm256_sll_epi32 (port, _mm_cvtsi32_si128 (shifts[p])));
+        }
+
+        _mm256_storeu_si256 ((__m256i*) (out + i), word);
+    }
+
+    packPortsScalar (scans, out, i, numScans, numPorts, shifts);
+}
+
+NIDAQ_TARGET ("avx512f")
+static void packPortsAVX512 (const uint32_t* scans, uint32_t* out, int numScans, int numPorts, const int* shifts)
+{
+    const __m512i scanOffsets = _mm512_mullo_epi32 (_mm512_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32 (numPorts));
+
+    int i = 0;
+    for (; i + 16 <= numScans; i += 16)
+    {
+        const int* base = (const int*) (scans + i * numPorts);
+        __m512i word = _mm512_setzero_si512();
+
+        for (int p = 0; p < numPorts; p++)
+        {
+            __m512i port = _mm512_i32gather_epi32 (scanOffsets, base + p, 4);
+            word = _mm512_or_si512 (word, _mm512_sll_epi32 (port, _mm_cvtsi32_si128 (shifts[p])));
+        }
+
+        _mm512_storeu_si512 ((void*) (out + i), word);
+    }
+
+    packPortsScalar (scans, out, i, numScans, numPorts, shifts);
+}
+
+#endif
+
+PortPacker::PortPacker() : simdLevel (getSupportedSIMDLevel())
+{
+}
+
+void PortPacker::prepare (int numPorts_, const int* shifts_)
+{
+    numPorts = numPorts_;
+    shifts.assign (shifts_, shifts_ + numPorts);
+}
+
+void PortPacker::setSIMDLevel (SIMD_LEVEL level)
+{
+    simdLevel = level < getSupportedSIMDLevel() ? level : getSupportedSIMDLevel();
+}
+
+void PortPacker::pack (const uint32_t* scans, uint32_t* out, int numScans) const
+{
+    if (numScans <= 0 || numPorts == 0)
+        return;
+
+    /* SSE2 has no gather, so it shares the scalar loop */
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            packPortsAVX512 (scans, out, numScans, numPorts, shifts.data());
+            return;
+        case SIMD_AVX2:
+            packPortsAVX2 (scans, out, numScans, numPorts, shifts.data());
+            return;
+#endif
+        default:
+            packPortsScalar (scans, out, 0, numScans, numPorts, shifts.data());
+            return;
+    }
+}
+
+/*********************************************/
+// SampleConverter
+/*********************************************/
+
+SampleConverter::SampleConverter() : simdLevel (getSupportedSIMDLevel())
+{
+}
+
+void SampleConverter::setSIMDLevel (SIMD_LEVEL level)
+{
+    simdLevel = level < getSupportedSIMDLevel() ? level : getSupportedSIMDLevel();
+}
+
+void SampleConverter::prepare (int numChannels_, const uint32_t* enableMasks, const float* coeffs, int numCoeffs_)
+{
+    numChannels = numChannels_;
+    numCoeffs = coeffs != nullptr ? (numCoeffs_ < maxCoeffs ? numCoeffs_ : maxCoeffs) : 0;
+    period = numChannels * PATTERN_SCANS;
+
+    maskPattern.resize (period);
+    for (int n = 0; n < maxCoeffs; n++)
+        coeffPatterns[n].assign (n < numCoeffs ? period : 0, 0.0f);
+
+    for (int i = 0; i < period; i++)
+    {
+        const int channel = i % numChannels;
+
+        maskPattern[i] = enableMasks[channel];
+
+        for (int n = 0; n < numCoeffs; n++)
+            coeffPatterns[n][i] = coeffs[channel * numCoeffs_ + n];
+    }
+}
+
+void SampleConverter::convert (const double* scans, float* out, int numScans) const
+{
+    const int count = numScans * numChannels;
+
+    if (count <= 0)
+        return;
+
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            convertF64AVX512 (scans, out, count, maskPattern.data(), period);
+            return;
+        case SIMD_AVX2:
+            convertF64AVX2 (scans, out, count, maskPattern.data(), period);
+            return;
+        case SIMD_SSE2:
+            convertF64SSE2 (scans, out, count, maskPattern.data(), period);
+            return;
+#endif
+        default:
+            convertF64Scalar (scans, out, count, maskPattern.data(), period, 0);
+            return;
+    }
+}
+
+void SampleConverter::convert (const int16_t* scans, float* out, int numScans) const
+{
+    const int count = numScans * numChannels;
+
+    if (count <= 0 || numCoeffs == 0)
+        return;
+
+    const float* k[maxCoeffs];
+    for (int n = 0; n < maxCoeffs; n++)
+        k[n] = coeffPatterns[n].data();
+
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            convertI16AVX512 (scans, out, count, maskPattern.data(), k, numCoeffs, period);
+            return;
+        case SIMD_AVX2:
+            convertI16AVX2 (scans, out, count, maskPattern.data(), k, numCoeffs, period);
+            return;
+        case SIMD_SSE2:
+            convertI16SSE2 (scans, out, count, maskPattern.data(), k, numCoeffs, period);
+            return;
+#endif
+        default:
+            convertI16Scalar (scans, out, count, maskPattern.data(), k, numCoeffs, period, 0);
+            return;
+    }
+}
+
+/*********************************************/
+// Timestamp ramps
+/*********************************************/
+
+/* Each value is computed from its own index rather than accumulated, so there is
+   no drift over long blocks and every variant rounds identically */
+
+static void fillRampScalar (double* out, int start, int count, double first, double step)
+{
+    for (int i = start; i < count; i++)
+        out[i] = first + double (i) * step;
+}
+
+#if NIDAQ_X86
+
+NIDAQ_TARGET ("sse2")
+static void fillRampSSE2 (double* out, int count, double first, double step)
+{
+    const __m128d f = _mm_set1_pd (first);
+    const __m128d s = _mm_set1_pd (step);
+    const __m128d lanes = _mm_setr_pd (0, 1);
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d index = _mm_add_pd (_mm_set1_pd (double (i)), lanes);
+        _mm_storeu_pd (out + i, _mm_add_pd (f, _mm_mul_pd (index, s)));
+    }
+
+    fillRampScalar (out, i, count, first, step);
+}
+
+NIDAQ_TARGET ("avx2")
+static void fillRampAVX2 (double* out, int count, double first, double step)
+{
+    const __m256d f = _mm256_set1_pd (first);
+    const __m256d s = _mm256_set1_pd (step);
+    const __m256d lanes = _mm256_setr_pd (0, 1, 2, 3);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d index = _mm256_add_pd (_mm256_set1_pd (double (i)), lanes);
+        _mm256_storeu_pd (out + i, _mm256_add_pd (f, _mm256_mul_pd (index, s)));
+    }
+
+    fillRampScalar (out, i, count, first, step);
+}
+
+NIDAQ_TARGET ("avx512f")
+static void fillRampAVX512 (double* out, int count, double first, double step)
+{
+    const __m512d f = _mm512_set1_pd (first);
+    const __m512d s = _mm512_set1_pd (step);
+    const __m512d lanes = _mm512_setr_pd (0, 1, 2, 3, 4, 5, 6, 7);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m512d index = _mm512_add_pd (_mm512_set1_pd (double (i)), lanes);
+        _mm512_storeu_pd (out + i, _mm512_add_pd (f, _mm512_mul_pd (index, s)));
+    }
+
+    fillRampScalar (out, i, count, first, step);
+}
+
+#endif
+
+RampFiller::RampFiller() : simdLevel (getSupportedSIMDLevel())
+{
+}
+
+void RampFiller::setSIMDLevel (SIMD_LEVEL level)
+{
+    simdLevel = level < getSupportedSIMDLevel() ? level : getSupportedSIMDLevel();
+}
+
+void RampFiller::fill (double* out, int count, double first, double step) const
+{
+    if (count <= 0)
+        return;
+
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            fillRampAVX512 (out, count, first, step);
+            return;
+        case SIMD_AVX2:
+            fillRampAVX2 (out, count, first, step);
+            return;
+        case SIMD_SSE2:
+            fillRampSSE2 (out, count, first, step);
+            return;
+#endif
+        default:
+            fillRampScalar (out, 0, count, first, step);
+            return;
+    }
+}
+
+/*********************************************/
+// Sample clock fit
+/*********************************************/
+
+void SampleClockFit::reset (double nominalPeriod_)
+{
+    nominalPeriod = nominalPeriod_;
+    numAnchors = 0;
+    meanX = meanY = 0;
+    cxx = cxy = cyy = 0;
+}
+
+void SampleClockFit::addAnchor (int64_t sampleIndex, double hostTime)
+{
+    if (numAnchors == 0)
+    {
+        firstIndex = sampleIndex;
+        firstTime = hostTime;
+    }
+
+    lastIndex = sampleIndex;
+
+    /* Welford-style update of the means and co-moments */
+    const double x = double (sampleIndex - firstIndex);
+    const double y = hostTime - firstTime;
+
+    numAnchors++;
+
+    const double dx = x - meanX;
+    const double dy = y - meanY;
+
+    meanX += dx / numAnchors;
+    meanY += dy / numAnchors;
+
+    cxx += dx * (x - meanX);
+    cxy += dx * (y - meanY);
+    cyy += dy * (y - meanY);
+}
+
+double SampleClockFit::getSamplePeriod() const
+{
+    /* Over short spans read jitter dominates the slope, so hold the nominal period until then */
+    if (numAnchors < 2 || cxx <= 0 || (lastIndex - firstIndex) * nominalPeriod < minFitSeconds)
+        return nominalPeriod;
+
+    return cxy / cxx;
+}
+
+double SampleClockFit::getHostTime (int64_t sampleIndex) const
+{
+    return firstTime + meanY + getSamplePeriod() * (double (sampleIndex - firstIndex) - meanX);
+}
+
+double SampleClockFit::getDriftPpm() const
+{
+    return (getSamplePeriod() / nominalPeriod - 1.0) * 1e6;
+}
+
+double SampleClockFit::getResidualRms() const
+{
+    if (numAnchors < 2)
+        return 0;
+
+    const double period = getSamplePeriod();
+    const double sumSquares = cyy - 2.0 * period * cxy + period * period * cxx;
+
+    return sqrt ((sumSquares > 0 ? sumSquares : 0.0) / numAnchors);
+}
+
+/*********************************************/
+// Decimation filter
+/*********************************************/
+
+/* One output scan: out[c] = sum over k of taps[k] * x[c] k scans before newest. Every variant
+   accumulates the taps in the same order, one channel per lane, so the results are identical */
+
+typedef void (*FilterScanFn) (const float* newest, int numChannels, const float* taps, int numTaps, float* out);
+
+static void filterScanScalar (const float* newest, int start, int numChannels, const float* taps, int numTaps, float* out)
+{
+    for (int c = start; c < numChannels; c++)
+    {
+        float acc = 0.0f;
+        for (int k = 0; k < numTaps; k++)
+            acc = acc + taps[k] * newest[c - k * numChannels];
+        out[c] = acc;
+    }
+}
+
+static void filterScanScalar (const float* newest, int numChannels, const float* taps, int numTaps, float* out)
+{
+    filterScanScalar (newest, 0, numChannels, taps, numTaps, out);
+}
+
+#if NIDAQ_X86
+
+/* Four independent accumulators hide the add latency when there are enough channels */
+
+NIDAQ_TARGET ("sse2")
+static void filterScanSSE2 (const float* newest, int numChannels, const float* taps, int numTaps, float* out)
+{
+    int c = 0;
+
+    for (; c + 16 <= numChannels; c += 16)
+    {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+
+        const float* x = newest + c;
+        for (int k = 0; k < numTaps; k++, x -= numChannels)
+        {
+            const __m128 h = _mm_set1_ps (taps[k]);
+            acc0 = _mm_add_ps (acc0, _mm_mul_ps (h, _mm_loadu_ps (x)));
+            acc1 = _mm_add_ps (acc1, _mm_mul_ps (h, _mm_loadu_ps (x + 4)));
+            acc2 = _mm_add_ps (acc2, _mm_mul_ps (h, _mm_loadu_ps (x + 8)));
+            acc3 = _mm_add_ps (acc3, _mm_mul_ps (h, _mm_loadu_ps (x + 12)));
+        }
+
+        _mm_storeu_ps (out + c, acc0);
+        _mm_storeu_ps (out + c + 4, acc1);
+        _mm_storeu_ps (out + c + 8, acc2);
+        _mm_storeu_ps (out + c + 12, acc3);
+    }
+
+    for (; c + 4 <= numChannels; c += 4)
+    {
+        __m128 acc = _mm_setzero_ps();
+
+        const float* x = newest + c;
+        for (int k = 0; k < numTaps; k++, x -= numChannels)
+            acc = _mm_add_ps (acc, _mm_mul_ps (_mm_set1_ps (taps[k]), _mm_loadu_ps (x)));
+
+        _mm_storeu_ps (out + c, acc);
+    }
+
+    filterScanScalar (newest, c, numChannels, taps, numTaps, out);
+}
+
+NIDAQ_TARGET ("avx2")
+static void filterScanAVX2 (const float* newest, int numChannels, const float* taps, int numTaps, float* out)
+{
+    int c = 0;
+
+    for (; c + 32 <= numChannels; c += 32)
+    {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+
+        const float* x = newest + c;
+        for (int k = 0; k < numTaps; k++, x -= numChannels)
+        {
+            const __m256 h = _mm256_set1_ps (taps[k]);
+            acc0 = _mm256_add_ps (acc0, _mm256_mul_ps (h, _mm256_loadu_ps (x)));
+            acc1 = _mm256_add_ps (acc1, _mm256_mul_ps (h, _mm256_loadu_ps (x + 8)));
+            acc2 = _mm256_add_ps (acc2, _mm256_mul_ps (h, _mm256_loadu_ps (x + 16)));
+            acc3 = _mm256_add_ps (acc3, _mm256_mul_ps (h, _mm256_loadu_ps (x + 24)));
+        }
+
+        _mm256_storeu_ps (out + c, acc0);
+        _mm256_storeu_ps (out + c + 8, acc1);
+        _mm256_storeu_ps (out + c + 16, acc2);
+        _mm256_storeu_ps (out + c + 24, acc3);
+    }
+
+    for (; c + 8 <= numChannels; c += 8)
+    {
+        __m256 acc = _mm256_setzero_ps();
+
+        const float* x = newest + c;
+        for (int k = 0; k < numTaps; k++, x -= numChannels)
+            acc = _mm256_add_ps (acc, _mm256_mul_ps (_mm256_set1_ps (taps[k]), _mm256_loadu_ps (x)));
+
+        _mm256_storeu_ps (out + c, acc);
+    }
+
+    filterScanScalar (newest, c, numChannels, taps, numTaps, out);
+}
+
+NIDAQ_TARGET ("avx512f")
+static void filterScanAVX512 (const float* newest, int numChannels, const float* taps, int numTaps, float* out)
+{
+    int c = 0;
+
+    for (; c + 64 <= numChannels; c += 64)
+    {
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+
+        const float* x = newest + c;
+        for (int k = 0; k < numTaps; k++, x -= numChannels)
+        {
+            const __m512 h = _mm512_set1_ps (taps[k]);
+            acc0 = _mm512_add_ps (acc0, _mm512_mul_ps (h, _mm512_loadu_ps (x)));
+            acc1 = _mm512_add_ps (acc1, _mm512_mul_ps (h, _mm512_loadu_ps (x + 16)));
+            acc2 = _mm512_add_ps (acc2, _mm512_mul_ps (h, _mm512_loadu_ps (x + 32)));
+            acc3 = _mm512_add_ps (acc3, _mm512_mul_ps (h, _mm512_loadu_ps (x + 48)));
+        }
+
+        _mm512_storeu_ps (out + c, acc0);
+        _mm512_storeu_ps (out + c + 16, acc1);
+        _mm512_storeu_ps (out + c + 32, acc2);
+        _mm512_storeu_ps (out + c + 48, acc3);
+    }
+
+    /* Remaining channels, the last vector masked */
+    for (; c < numChannels; c += 16)
+    {
+        const __mmask16 m = numChannels - c >= 16 ? (__mmask16) 0xffff : (__mmask16) ((1u << (numChannels - c)) - 1);
+        __m512 acc = _mm512_setzero_ps();
+
+        const float* x = newest + c;
+        for (int k = 0; k < numTaps; k++, x -= numChannels)
+            acc = _mm512_add_ps (acc, _mm512_mul_ps (_mm512_set1_ps (taps[k]), _mm512_maskz_loadu_ps (m, x)));
+
+        _mm512_mask_storeu_ps (out + c, m, acc);
+    }
+}
+
+#endif
+
+Decimator::Decimator() : simdLevel (getSupportedSIMDLevel())
+{
+}
+
+void Decimator::setSIMDLevel (SIMD_LEVEL level)
+{
+    simdLevel = level < getSupportedSIMDLevel() ? level : getSupportedSIMDLevel();
+}
+
+void Decimator::prepare (int numChannels_, int factor_, int numTaps, int maxScans_)
+{
+    numChannels = numChannels_;
+    factor = factor_ > 1 ? factor_ : 1;
+    maxScans = maxScans_ > 1 ? maxScans_ : 1;
+    numTaps = numTaps > 1 ? numTaps : 1;
+
+    /* Pass band to 80% of the output Nyquist frequency, Blackman window, unity gain at DC */
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.4 / factor;
+
+    std::vector<double> h (numTaps);
+    double sum = 0;
+
+    for (int k = 0; k < numTaps; k++)
+    {
+        const double m = k - 0.5 * (numTaps - 1);
+        const double sinc = m == 0 ? 2.0 * cutoff : sin (2.0 * pi * cutoff * m) / (pi * m);
+        const double w = 2.0 * pi * (k + 1) / (numTaps + 1);
+
+        h[k] = sinc * (0.42 - 0.5 * cos (w) + 0.08 * cos (2.0 * w));
+        sum += h[k];
+    }
+
+    taps.resize (numTaps);
+    for (int k = 0; k < numTaps; k++)
+        taps[k] = float (h[k] / sum);
+
+    history.assign (size_t (numTaps - 1 + maxScans) * numChannels, 0.0f);
+
+    /* The first output covers the first factor input scans */
+    phase = factor - 1;
+}
+
+int Decimator::process (const float* scans, int numScans, float* out, int* inputIndices)
+{
+    if (numScans <= 0 || numChannels <= 0)
+        return 0;
+
+    /* Blocks larger than the history was sized for are filtered in pieces */
+    if (numScans > maxScans)
+    {
+        int count = process (scans, maxScans, out, inputIndices);
+        int rest = process (scans + size_t (maxScans) * numChannels, numScans - maxScans, out + size_t (count) * numChannels, inputIndices + count);
+
+        for (int i = count; i < count + rest; i++)
+            inputIndices[i] += maxScans;
+
+        return count + rest;
+    }
+
+    FilterScanFn filterScan = filterScanScalar;
+
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            filterScan = filterScanAVX512;
+            break;
+        case SIMD_AVX2:
+            filterScan = filterScanAVX2;
+            break;
+        case SIMD_SSE2:
+            filterScan = filterScanSSE2;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    const int numTaps = (int) taps.size();
+    const size_t historyLength = size_t (numTaps - 1) * numChannels;
+
+    memcpy (history.data() + historyLength, scans, sizeof (float) * numScans * numChannels);
+
+    int count = 0;
+    int t = phase;
+
+    for (; t < numScans; t += factor)
+    {
+        filterScan (history.data() + historyLength + size_t (t) * numChannels, numChannels, taps.data(), numTaps, out + size_t (count) * numChannels);
+        inputIndices[count++] = t;
+    }
+
+    phase = t - numScans;
+
+    memmove (history.data(), history.data() + size_t (numScans) * numChannels, sizeof (float) * historyLength);
+
+    return count;
+}
+
+/*********************************************/
+// Biquad filter bank
+/*********************************************/
+
+/* Every variant evaluates y = b0 x + z1, z1 = (b1 x - a1 y) + z2, z2 = b2 x - a2 y in this
+   order, in double precision, so all of them round identically */
+
+static void filterBiquadsScalar (float* scan, int start, int numChannels, const BiquadBank::Section* sections, int numSections, double* state)
+{
+    for (int c = start; c < numChannels; c++)
+    {
+        double x = scan[c];
+
+        for (int s = 0; s < numSections; s++)
+        {
+            const BiquadBank::Section& k = sections[s];
+            double* z1 = state + size_t (2 * s) * numChannels;
+            double* z2 = z1 + numChannels;
+
+            const double y = k.b0 * x + z1[c];
+            z1[c] = k.b1 * x - k.a1 * y + z2[c];
+            z2[c] = k.b2 * x - k.a2 * y;
+            x = y;
+        }
+
+        scan[c] = float (x);
+    }
+}
+
+#if NIDAQ_X86
+
+NIDAQ_TARGET ("sse2")
+static void filterBiquadsSSE2 (float* scans, int numScans, int numChannels, const BiquadBank::Section* sections, int numSections, double* state)
+{
+    for (int i = 0; i < numScans; i++)
+    {
+        float* scan = scans + size_t (i) * numChannels;
+        int c = 0;
+
+        for (; c + 2 <= numChannels; c += 2)
+        {
+            __m128d x = _mm_cvtps_pd (_mm_castsi128_ps (_mm_loadl_epi64 ((const __m128i*) (scan + c))));
+
+            for (int s = 0; s < numSections; s++)
+            {
+                const BiquadBank::Section& k = sections[s];
+                double* z1 = state + size_t (2 * s) * numChannels + c;
+                double* z2 = z1 + numChannels;
+
+                const __m128d y = _mm_add_pd (_mm_mul_pd (_mm_set1_pd (k.b0), x), _mm_loadu_pd (z1));
+                _mm_storeu_pd (z1, _mm_add_pd (_mm_sub_pd (_mm_mul_pd (_mm_set1_pd (k.b1), x), _mm_mul_pd (_mm_set1_pd (k.a1), y)), _mm_loadu_pd (z2)));
+                _mm_storeu_pd (z2, _mm_sub_pd (_mm_mul_pd (_mm_set1_pd (k.b2), x), _mm_mul_pd (_mm_set1_pd (k.a2), y)));
+                x = y;
+            }
+
+            _mm_storel_epi64 ((__m128i*) (scan + c), _mm_castps_si128 (_mm_cvtpd_ps (x)));
+        }
+
+        filterBiquadsScalar (scan, c, numChannels, sections, numSections, state);
+    }
+}
+
+NIDAQ_TARGET ("avx2")
+static void filterBiquadsAVX2 (float* scans, int numScans, int numChannels, const BiquadBank::Section* sections, int numSections, double* state)
+{
+    for (int i = 0; i < numScans; i++)
+    {
+        float* scan = scans + size_t (i) * numChannels;
+        int c = 0;
+
+        for (; c + 4 <= numChannels; c += 4)
+        {
+            __m256d x = _mm256_cvtps_pd (_mm_loadu_ps (scan + c));
+
+            for (int s = 0; s < numSections; s++)
+            {
+                const BiquadBank::Section& k = sections[s];
+                double* z1 = state + size_t (2 * s) * numChannels + c;
+                double* z2 = z1 + numChannels;
+
+                const __m256d y = _mm256_add_pd (_mm256_mul_pd (_mm256_set1_pd (k.b0), x), _mm256_loadu_pd (z1));
+                _mm256_storeu_pd (z1, _mm256_add_pd (_mm256_sub_pd (_mm256_mul_pd (_mm256_set1_pd (k.b1), x), _mm256_mul_pd (_mm256_set1_pd (k.a1), y)), _mm256_loadu_pd (z2)));
+                _mm256_storeu_pd (z2, _mm256_sub_pd (_mm256_mul_pd (_mm256_set1_pd (k.b2), x), _mm256_mul_pd (_mm256_set1_pd (k.a2), y)));
+                x = y;
+            }
+
+            _mm_storeu_ps (scan + c, _mm256_cvtpd_ps (x));
+        }
+
+        filterBiquadsScalar (scan, c, numChannels, sections, numSections, state);
+    }
+}
+
+NIDAQ_TARGET ("avx512f")
+static void filterBiquadsAVX512 (float* scans, int numScans, int numChannels, const BiquadBank::Section* sections, int numSections, double* state)
+{
+    for (int i = 0; i < numScans; i++)
+    {
+        float* scan = scans + size_t (i) * numChannels;
+        int c = 0;
+
+        for (; c + 8 <= numChannels; c += 8)
+        {
+            __m512d x = _mm512_cvtps_pd (_mm256_loadu_ps (scan + c));
+
+            for (int s = 0; s < numSections; s++)
+            {
+                const BiquadBank::Section& k = sections[s];
+                double* z1 = state + size_t (2 * s) * numChannels + c;
+                double* z2 = z1 + numChannels;
+
+                const __m512d y = _mm512_add_pd (_mm512_mul_pd (_mm512_set1_pd (k.b0), x), _mm512_loadu_pd (z1));
+                _mm512_storeu_pd (z1, _mm512_add_pd (_mm512_sub_pd (_mm512_mul_pd (_mm512_set1_pd (k.b1), x), _mm512_mul_pd (_mm512_set1_pd (k.a1), y)), _mm512_loadu_pd (z2)));
+                _mm512_storeu_pd (z2, _mm512_sub_pd (_mm512_mul_pd (_mm512_set1_pd (k.b2), x), _mm512_mul_pd (_mm512_set1_pd (k.a2), y)));
+                x = y;
+            }
+
+            _mm256_storeu_ps (scan + c, _mm512_cvtpd_ps (x));
+        }
+
+        filterBiquadsScalar (scan, c, numChannels, sections, numSections, state);
+    }
+}
+
+#endif
+
+/* RBJ audio EQ cookbook designs */
+
+BiquadBank::Section BiquadBank::highPass (double cutoff, double sampleRate)
+{
+    const double w = 2.0 * 3.14159265358979323846 * cutoff / sampleRate;
+    const double alpha = sin (w) / (2.0 * sqrt (0.5));
+    const double a0 = 1.0 + alpha;
+
+    Section k;
+    k.b0 = (1.0 + cos (w)) / 2.0 / a0;
+    k.b1 = -(1.0 + cos (w)) / a0;
+    k.b2 = k.b0;
+    k.a1 = -2.0 * cos (w) / a0;
+    k.a2 = (1.0 - alpha) / a0;
+    return k;
+}
+
+BiquadBank::Section BiquadBank::notch (double frequency, double sampleRate, double q)
+{
+    const double w = 2.0 * 3.14159265358979323846 * frequency / sampleRate;
+    const double alpha = sin (w) / (2.0 * q);
+    const double a0 = 1.0 + alpha;
+
+    Section k;
+    k.b0 = 1.0 / a0;
+    k.b1 = -2.0 * cos (w) / a0;
+    k.b2 = k.b0;
+    k.a1 = k.b1;
+    k.a2 = (1.0 - alpha) / a0;
+    return k;
+}
+
+BiquadBank::BiquadBank() : simdLevel (getSupportedSIMDLevel())
+{
+}
+
+void BiquadBank::setSIMDLevel (SIMD_LEVEL level)
+{
+    simdLevel = level < getSupportedSIMDLevel() ? level : getSupportedSIMDLevel();
+}
+
+void BiquadBank::prepare (int numChannels_, const Section* sections_, int numSections)
+{
+    numChannels = numChannels_;
+
+    numSections = numSections < maxSections ? numSections : maxSections;
+    sections.assign (sections_, sections_ + (numSections > 0 ? numSections : 0));
+
+    state.assign (size_t (2 * sections.size()) * numChannels, 0.0);
+}
+
+void BiquadBank::process (float* scans, int numScans)
+{
+    if (numScans <= 0 || numChannels <= 0 || sections.empty())
+        return;
+
+    const int numSections = (int) sections.size();
+
+    switch (simdLevel)
+    {
+#if NIDAQ_X86
+        case SIMD_AVX512:
+            filterBiquadsAVX512 (scans, numScans, numChannels, sections.data(), numSections, state.data());
+            return;
+        case SIMD_AVX2:
+            filterBiquadsAVX2 (scans, numScans, numChannels, sections.data(), numSections, state.data());
+            return;
+        case SIMD_SSE2:
+            filterBiquadsSSE2 (scans, numScans, numChannels, sections.data(), numSections, state.data());
+            return;
+#endif
+        default:
+            for (int i = 0; i < numScans; i++)
+                filterBiquadsScalar (scans + size_t (i) * numChannels, 0, numChannels, sections.data(), numSections, state.data());
+            return;
+    }
+}
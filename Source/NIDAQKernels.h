@@ -0,0 +1,348 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NIDAQKERNELS_H__
+#define __NIDAQKERNELS_H__
+
+#include <stdint.h>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* Vector instruction sets the sample conversion kernels are built for */
+enum SIMD_LEVEL
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512
+};
+
+/* Best instruction set supported by both this CPU and the OS (detected once via CPUID) */
+SIMD_LEVEL getSupportedSIMDLevel();
+
+const char* getSIMDLevelName (SIMD_LEVEL level);
+
+/* Index of the lowest set bit; value must be non-zero */
+inline int findLowestSetBit (uint32_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward (&index, value);
+    return int (index);
+#else
+    return __builtin_ctz (value);
+#endif
+}
+
+/* Index of the highest set bit; value must be non-zero */
+inline int findHighestSetBit (uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    if (_BitScanReverse (&index, (unsigned long) (value >> 32)))
+        return int (index) + 32;
+    _BitScanReverse (&index, (unsigned long) value);
+    return int (index);
+#else
+    return 63 - __builtin_clzll (value);
+#endif
+}
+
+/**
+
+    Converts interleaved DAQmx scans (DAQmx_Val_GroupByScanNumber) into the float
+    layout published to the DataBuffer, zeroing disabled channels on the way.
+
+    Raw 16-bit counts are scaled with a per-channel polynomial of up to
+    maxCoeffs terms. Every SIMD variant produces bit-identical output to the
+    scalar reference.
+
+*/
+class SampleConverter
+{
+public:
+    static const int maxCoeffs = 4;
+
+    /** Selects the best supported instruction set */
+    SampleConverter();
+
+    /** Per-channel setup: enableMasks[ch] is 0xffffffff for enabled channels, 0 for disabled ones.
+        coeffs holds numCoeffs polynomial terms per channel (lowest order first) for raw conversion. */
+    void prepare (int numChannels, const uint32_t* enableMasks, const float* coeffs = nullptr, int numCoeffs = 0);
+
+    /** Overrides the instruction set (clamped to what the CPU supports) */
+    void setSIMDLevel (SIMD_LEVEL level);
+    SIMD_LEVEL getSIMDLevel() const { return simdLevel; }
+
+    /** Converts numScans scans of scaled volts */
+    void convert (const double* scans, float* out, int numScans) const;
+
+    /** Converts numScans scans of raw ADC counts */
+    void convert (const int16_t* scans, float* out, int numScans) const;
+
+private:
+    SIMD_LEVEL simdLevel;
+
+    int numChannels = 0;
+    int numCoeffs = 0;
+
+    /* Per-channel values repeated over 16 scans, so that any vector starting at a
+       multiple of the vector width within one period lines up with its channels */
+    int period = 0;
+    std::vector<uint32_t> maskPattern;
+    std::vector<float> coeffPatterns[maxCoeffs];
+};
+
+/**
+
+    Finds the samples where the masked digital word differs from the one before,
+    so per-sample event work only happens where a line actually changed.
+
+*/
+class TransitionDetector
+{
+public:
+    /** Selects the best supported instruction set */
+    TransitionDetector();
+
+    /** Overrides the instruction set (clamped to what the CPU supports) */
+    void setSIMDLevel (SIMD_LEVEL level);
+    SIMD_LEVEL getSIMDLevel() const { return simdLevel; }
+
+    /** Writes the index and new masked word of each change (relative to previous, the masked
+        word before the block) and returns how many there were. Outputs hold up to numSamples entries. */
+    int detect (const uint32_t* codes, int numSamples, uint32_t mask, uint32_t previous, int* indices, uint32_t* words) const;
+
+private:
+    SIMD_LEVEL simdLevel;
+};
+
+/**
+
+    Merges the per-port words of a multi-port digital read (one word per port per scan,
+    grouped by scan) into a single event word per scan, each port at its own bit offset.
+
+*/
+class PortPacker
+{
+public:
+    /** Selects the best supported instruction set */
+    PortPacker();
+
+    /** shifts[p] is the bit offset of port p in the event word (ports at 32 or above are dropped) */
+    void prepare (int numPorts, const int* shifts);
+
+    /** Overrides the instruction set (clamped to what the CPU supports) */
+    void setSIMDLevel (SIMD_LEVEL level);
+    SIMD_LEVEL getSIMDLevel() const { return simdLevel; }
+
+    /** Packs numScans scans of numPorts words each */
+    void pack (const uint32_t* scans, uint32_t* out, int numScans) const;
+
+private:
+    SIMD_LEVEL simdLevel;
+
+    int numPorts = 0;
+    std::vector<int> shifts;
+};
+
+/**
+
+    Fills a block with evenly spaced values (first + i * step), used for per-sample timestamps.
+
+*/
+class RampFiller
+{
+public:
+    /** Selects the best supported instruction set */
+    RampFiller();
+
+    /** Overrides the instruction set (clamped to what the CPU supports) */
+    void setSIMDLevel (SIMD_LEVEL level);
+    SIMD_LEVEL getSIMDLevel() const { return simdLevel; }
+
+    void fill (double* out, int count, double first, double step) const;
+
+private:
+    SIMD_LEVEL simdLevel;
+};
+
+/**
+
+    Running least-squares fit of host time against sample index, fed with one anchor
+    per read (the last sample of the block and the host time its read returned).
+
+    The slope gives the device sample period as measured by the host clock, so its
+    deviation from the nominal period is the drift between the two clocks.
+
+*/
+class SampleClockFit
+{
+public:
+    /** Anchor span before the fitted sample period replaces the nominal one */
+    static constexpr double minFitSeconds = 5.0;
+
+    void reset (double nominalPeriod);
+    void addAnchor (int64_t sampleIndex, double hostTime);
+
+    /** Host time of a sample according to the current fit */
+    double getHostTime (int64_t sampleIndex) const;
+
+    /** Sample period in host seconds (nominal until the anchors span minFitSeconds) */
+    double getSamplePeriod() const;
+
+    /** Device clock relative to the host clock, in parts per million (positive when slow) */
+    double getDriftPpm() const;
+
+    /** RMS distance of the anchors from the fitted line, in seconds */
+    double getResidualRms() const;
+
+    int64_t getNumAnchors() const { return numAnchors; }
+
+private:
+    double nominalPeriod = 0;
+
+    /* Anchors are stored relative to the first one to keep the sums well conditioned */
+    int64_t firstIndex = 0;
+    int64_t lastIndex = 0;
+    double firstTime = 0;
+
+    int64_t numAnchors = 0;
+    double meanX = 0;
+    double meanY = 0;
+    double cxx = 0;
+    double cxy = 0;
+    double cyy = 0;
+};
+
+/**
+
+    Low-pass filters interleaved scans and keeps every factor-th one, for a reduced-rate
+    copy of the analog inputs.
+
+    Only the kept outputs are computed (the polyphase form of the FIR), and each output
+    accumulates across channels so the vector lanes stay busy regardless of the filter
+    length. The filter history is carried from one block to the next.
+
+*/
+class Decimator
+{
+public:
+    /** Selects the best supported instruction set */
+    Decimator();
+
+    /** Designs a windowed-sinc low-pass of numTaps taps for the given factor and clears
+        the history. Blocks passed to process() hold at most maxScans scans. */
+    void prepare (int numChannels, int factor, int numTaps, int maxScans);
+
+    /** Overrides the instruction set (clamped to what the CPU supports) */
+    void setSIMDLevel (SIMD_LEVEL level);
+    SIMD_LEVEL getSIMDLevel() const { return simdLevel; }
+
+    /** Filters numScans scans and writes one output scan per factor inputs, with the index
+        of the newest input scan each one covers. Returns the number of outputs written
+        (at most numScans / factor + 1). */
+    int process (const float* scans, int numScans, float* out, int* inputIndices);
+
+    int getFactor() const { return factor; }
+    int getNumTaps() const { return (int) taps.size(); }
+
+    /** Index of the next output's input scan within the next block (factor - 1 after prepare) */
+    int getPhase() const { return phase; }
+
+    /** Delay of the linear-phase filter, in input samples */
+    double getGroupDelay() const { return 0.5 * (double (taps.size()) - 1.0); }
+
+private:
+    SIMD_LEVEL simdLevel;
+
+    int numChannels = 0;
+    int factor = 1;
+    int maxScans = 0;
+
+    /* Position of the next output within the next block */
+    int phase = 0;
+
+    std::vector<float> taps;
+
+    /* The last numTaps - 1 scans of the previous block followed by the current block */
+    std::vector<float> history;
+};
+
+/**
+
+    Cascade of biquad sections applied in place to interleaved scans, with the same
+    sections on every channel (high-pass and mains notch conditioning).
+
+    The filter state is kept as structure-of-arrays (one contiguous row of channels per
+    section and delay), so each scan is filtered with a single pass across its channels,
+    one channel per vector lane, and the state carries over from one block to the next.
+    Arithmetic is in double precision, which keeps sub-hertz poles where they were designed.
+
+*/
+class BiquadBank
+{
+public:
+    static const int maxSections = 4;
+
+    /* Transposed direct form II coefficients, normalised so that a0 = 1 */
+    struct Section
+    {
+        double b0, b1, b2, a1, a2;
+    };
+
+    /** Second-order Butterworth high-pass */
+    static Section highPass (double cutoff, double sampleRate);
+
+    /** Notch with bandwidth frequency / q */
+    static Section notch (double frequency, double sampleRate, double q);
+
+    /** Selects the best supported instruction set */
+    BiquadBank();
+
+    /** Sets the sections (up to maxSections) and clears the filter state */
+    void prepare (int numChannels, const Section* sections, int numSections);
+
+    /** Overrides the instruction set (clamped to what the CPU supports) */
+    void setSIMDLevel (SIMD_LEVEL level);
+    SIMD_LEVEL getSIMDLevel() const { return simdLevel; }
+
+    int getNumSections() const { return (int) sections.size(); }
+
+    /** Filters numScans scans in place */
+    void process (float* scans, int numScans);
+
+private:
+    SIMD_LEVEL simdLevel;
+
+    int numChannels = 0;
+    std::vector<Section> sections;
+
+    /* Per section: a row of z1 then a row of z2, numChannels values each */
+    std::vector<double> state;
+};
+
+#endif // __NIDAQKERNELS_H__
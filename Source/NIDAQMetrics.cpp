@@ -0,0 +1,163 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NIDAQMetrics.h"
+
+DeviceMetrics getDeviceMetrics (NIDAQmx* nidaq)
+{
+    const AcquisitionStats& stats = nidaq->getStats();
+    const LatencyHistogram::Summary readDurations = nidaq->getReadDurations().getSummary();
+
+    DeviceMetrics metrics;
+
+    metrics.name = nidaq->device->getName().toStdString();
+    metrics.sampleRate = nidaq->getSampleRate();
+    metrics.samples = stats.getSamples();
+    metrics.reads = stats.getReads();
+    metrics.bytes = stats.getBytes();
+
+    metrics.hostBufferBacklog = nidaq->getBufferOccupancy();
+    metrics.hostBufferSize = nidaq->getHostBufferSize();
+    metrics.dataBufferFill = nidaq->getDataBufferFill();
+
+    metrics.overflows = stats.getOverflows();
+    metrics.restarts = stats.getRestarts();
+    metrics.lostSamples = nidaq->getLostSamples();
+
+    metrics.readP50 = readDurations.p50 * 1e-9;
+    metrics.readP99 = readDurations.p99 * 1e-9;
+    metrics.readP999 = readDurations.p999 * 1e-9;
+    metrics.readSeconds = stats.getReadSeconds();
+
+    metrics.readerCpuSeconds = nidaq->getReaderCpuSeconds();
+    metrics.processingCpuSeconds = nidaq->getProcessingCpuSeconds();
+
+    return metrics;
+}
+
+String formatMetrics (const Array<NIDAQmx*>& devices)
+{
+    std::vector<DeviceMetrics> snapshots;
+
+    for (auto* nidaq : devices)
+        snapshots.push_back (getDeviceMetrics (nidaq));
+
+    return String::fromUTF8 (formatMetrics (snapshots).c_str());
+}
+
+NIDAQMetricsServer::NIDAQMetricsServer (std::function<String()> getMetrics_)
+    : Thread ("NIDAQ Metrics"), getMetrics (getMetrics_)
+{
+}
+
+NIDAQMetricsServer::~NIDAQMetricsServer()
+{
+    stop();
+}
+
+bool NIDAQMetricsServer::setPort (int port_)
+{
+    if (port_ == port && (port == 0 || isThreadRunning()))
+        return true;
+
+    stop();
+
+    if (port_ <= 0)
+        return true;
+
+    if (! listener.createListener (port_, "127.0.0.1"))
+    {
+        LOGE ("NIDAQmx: could not serve metrics on 127.0.0.1:", port_);
+        return false;
+    }
+
+    port = port_;
+    startThread();
+
+    LOGC ("NIDAQmx: serving metrics at http://127.0.0.1:", port, "/metrics");
+
+    return true;
+}
+
+void NIDAQMetricsServer::stop()
+{
+    /* Closing the listener wakes the thread from waitForNextConnection */
+    signalThreadShouldExit();
+    listener.close();
+    stopThread (METRICS_TIMEOUT_MS * 2);
+
+    port = 0;
+}
+
+void NIDAQMetricsServer::run()
+{
+    while (! threadShouldExit())
+    {
+        ScopedPointer<StreamingSocket> client = listener.waitForNextConnection();
+
+        if (client == nullptr)
+            continue;
+
+        respond (*client);
+    }
+}
+
+void NIDAQMetricsServer::respond (StreamingSocket& client)
+{
+    char request[1024];
+    int received = 0;
+
+    /* Only the request line matters, but the headers are drained so the client sees a clean close */
+    while (received < int (sizeof (request)) - 1 && client.waitUntilReady (true, METRICS_TIMEOUT_MS) == 1)
+    {
+        const int numRead = client.read (request + received, int (sizeof (request)) - 1 - received, false);
+
+        if (numRead <= 0)
+            break;
+
+        received += numRead;
+        request[received] = 0;
+
+        if (strstr (request, "\r\n\r\n") != nullptr)
+            break;
+    }
+
+    StringArray requestLine = StringArray::fromTokens (String::fromUTF8 (request, received).upToFirstOccurrenceOf ("\r\n", false, false), " ", "");
+
+    String status = "404 Not Found";
+    String body = "Metrics are served at /metrics\n";
+
+    if (requestLine[0] == "GET" && requestLine[1].upToFirstOccurrenceOf ("?", false, false) == "/metrics")
+    {
+        status = "200 OK";
+        body = getMetrics();
+    }
+
+    const String response = "HTTP/1.1 " + status + "\r\n"
+                            + "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                            + "Content-Length: " + String ((int) body.getNumBytesAsUTF8()) + "\r\n"
+                            + "Connection: close\r\n\r\n"
+                            + body;
+
+    client.write (response.toRawUTF8(), (int) response.getNumBytesAsUTF8());
+}
@@ -0,0 +1,70 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NIDAQMETRICS_H__
+#define __NIDAQMETRICS_H__
+
+#include "NIDAQComponents.h"
+#include "NIDAQMetricsFormat.h"
+
+#include <functional>
+
+#define DEFAULT_METRICS_PORT 9464
+#define METRICS_TIMEOUT_MS 1000 // longest wait for a scraper to send its request
+
+/** Snapshot of the device's counters for one scrape */
+DeviceMetrics getDeviceMetrics (NIDAQmx* nidaq);
+
+/** Per-device acquisition health in the Prometheus text exposition format */
+String formatMetrics (const Array<NIDAQmx*>& devices);
+
+/**
+
+    Minimal HTTP listener on 127.0.0.1 serving GET /metrics, one request at a time.
+    Loopback only, so it can be scraped by a local agent (or curl) but is never
+    reachable from the network.
+
+*/
+class NIDAQMetricsServer : public Thread
+{
+public:
+    /** getMetrics is called on the server thread for each scrape */
+    NIDAQMetricsServer (std::function<String()> getMetrics);
+    ~NIDAQMetricsServer();
+
+    /** Listens on the given port, or stops listening when it is 0; false if the port cannot be bound */
+    bool setPort (int port);
+    int getPort() const { return port; }
+
+    void run() override;
+
+private:
+    void stop();
+    void respond (StreamingSocket& client);
+
+    std::function<String()> getMetrics;
+    StreamingSocket listener;
+    int port = 0;
+};
+
+#endif
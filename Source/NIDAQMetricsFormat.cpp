@@ -0,0 +1,117 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NIDAQMetricsFormat.h"
+
+#include <stdio.h>
+
+static std::string formatValue (double value)
+{
+    char text[32];
+    snprintf (text, sizeof (text), "%.9g", value);
+    return text;
+}
+
+static std::string formatValue (int64_t value)
+{
+    return std::to_string (value);
+}
+
+std::string escapeMetricLabel (const std::string& value)
+{
+    std::string escaped;
+
+    for (char c : value)
+    {
+        if (c == '\\')
+            escaped += "\\\\";
+        else if (c == '"')
+            escaped += "\\\"";
+        else if (c == '\n')
+            escaped += "\\n";
+        else
+            escaped += c;
+    }
+
+    return escaped;
+}
+
+static std::string deviceLabel (const DeviceMetrics& device)
+{
+    return "device=\"" + escapeMetricLabel (device.name) + "\"";
+}
+
+/* One metric family: its HELP and TYPE lines, then a sample per device */
+template <typename T>
+static void addFamily (std::string& text, const char* name, const char* type, const char* help,
+                       const std::vector<DeviceMetrics>& devices, T DeviceMetrics::*value)
+{
+    text += std::string ("# HELP ") + name + " " + help + "\n";
+    text += std::string ("# TYPE ") + name + " " + type + "\n";
+
+    for (const DeviceMetrics& device : devices)
+        text += std::string (name) + "{" + deviceLabel (device) + "} " + formatValue (device.*value) + "\n";
+}
+
+std::string formatMetrics (const std::vector<DeviceMetrics>& devices)
+{
+    std::string text;
+
+    addFamily (text, "nidaq_sample_rate_hz", "gauge", "Sample clock rate the driver runs at.", devices, &DeviceMetrics::sampleRate);
+    addFamily (text, "nidaq_samples_total", "counter", "Samples per channel read this run; rate() gives samples/s.", devices, &DeviceMetrics::samples);
+    addFamily (text, "nidaq_reads_total", "counter", "Driver reads this run.", devices, &DeviceMetrics::reads);
+    addFamily (text, "nidaq_read_bytes_total", "counter", "Bytes returned by the driver this run.", devices, &DeviceMetrics::bytes);
+    addFamily (text, "nidaq_host_buffer_backlog_samples", "gauge", "Samples per channel waiting in the DAQmx host buffer.", devices, &DeviceMetrics::hostBufferBacklog);
+    addFamily (text, "nidaq_host_buffer_size_samples", "gauge", "DAQmx host buffer size per channel (0 when not buffered).", devices, &DeviceMetrics::hostBufferSize);
+    addFamily (text, "nidaq_data_buffer_fill_samples", "gauge", "Samples per channel waiting in the GUI DataBuffer.", devices, &DeviceMetrics::dataBufferFill);
+    addFamily (text, "nidaq_overflows_total", "counter", "Host buffer overflows this run.", devices, &DeviceMetrics::overflows);
+    addFamily (text, "nidaq_restarts_total", "counter", "Task restarts after overflows, stalls or driver errors this run.", devices, &DeviceMetrics::restarts);
+    addFamily (text, "nidaq_lost_samples_total", "counter", "Samples per channel skipped across restarts this run.", devices, &DeviceMetrics::lostSamples);
+
+    text += "# HELP nidaq_read_duration_seconds Time spent in each driver read, including the wait for data.\n"
+            "# TYPE nidaq_read_duration_seconds summary\n";
+
+    for (const DeviceMetrics& device : devices)
+    {
+        const std::string label = deviceLabel (device);
+
+        text += "nidaq_read_duration_seconds{" + label + ",quantile=\"0.5\"} " + formatValue (device.readP50) + "\n";
+        text += "nidaq_read_duration_seconds{" + label + ",quantile=\"0.99\"} " + formatValue (device.readP99) + "\n";
+        text += "nidaq_read_duration_seconds{" + label + ",quantile=\"0.999\"} " + formatValue (device.readP999) + "\n";
+        text += "nidaq_read_duration_seconds_sum{" + label + "} " + formatValue (device.readSeconds) + "\n";
+        text += "nidaq_read_duration_seconds_count{" + label + "} " + formatValue (device.reads) + "\n";
+    }
+
+    text += "# HELP nidaq_thread_cpu_seconds_total CPU time used by the acquisition threads this run.\n"
+            "# TYPE nidaq_thread_cpu_seconds_total counter\n";
+
+    for (const DeviceMetrics& device : devices)
+    {
+        const std::string label = deviceLabel (device);
+
+        text += "nidaq_thread_cpu_seconds_total{" + label + ",thread=\"reader\"} " + formatValue (device.readerCpuSeconds) + "\n";
+        text += "nidaq_thread_cpu_seconds_total{" + label + ",thread=\"processing\"} " + formatValue (device.processingCpuSeconds) + "\n";
+    }
+
+    return text;
+}
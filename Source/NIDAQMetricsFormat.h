@@ -0,0 +1,67 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NIDAQMETRICSFORMAT_H__
+#define __NIDAQMETRICSFORMAT_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Plain C++ (no JUCE, no NI-DAQmx), so the exposition format can be tested on its own */
+
+/** Acquisition health of one device at the time of a scrape */
+struct DeviceMetrics
+{
+    std::string name;
+
+    double sampleRate = 0; // sample clock rate the driver runs at
+    int64_t samples = 0; // samples per channel read this run
+    int64_t reads = 0;
+    int64_t bytes = 0;
+
+    int64_t hostBufferBacklog = 0; // samples per channel
+    int64_t hostBufferSize = 0;
+    int64_t dataBufferFill = 0;
+
+    int64_t overflows = 0;
+    int64_t restarts = 0;
+    int64_t lostSamples = 0;
+
+    /* Read durations in seconds: quantiles from the histogram, total from the statistics block */
+    double readP50 = 0;
+    double readP99 = 0;
+    double readP999 = 0;
+    double readSeconds = 0;
+
+    double readerCpuSeconds = 0;
+    double processingCpuSeconds = 0;
+};
+
+/** Escapes a label value (backslash, double quote and newline) */
+std::string escapeMetricLabel (const std::string& value);
+
+/** All devices in the Prometheus text exposition format, one HELP and TYPE per family */
+std::string formatMetrics (const std::vector<DeviceMetrics>& devices);
+
+#endif
@@ -46,6 +46,8 @@ NIDAQThread::NIDAQThread (SourceNode* sn) : DataThread (sn),
 
     dm->scanForDevices();
 
+    metricsServer = new NIDAQMetricsServer ([this] { return getMetrics(); });
+
     if (dm->getNumAvailableDevices() > 0 && dm->getDeviceAtIndex (0)->getName() != "Simulated")
         inputAvailable = true;
 
@@ -54,6 +56,8 @@ NIDAQThread::NIDAQThread (SourceNode* sn) : DataThread (sn),
 
 NIDAQThread::~NIDAQThread()
 {
+    /* Before the devices it reads go away */
+    metricsServer = nullptr;
 }
 
 void NIDAQThread::initialize (bool signalChainIsLoading)
@@ -62,10 +66,64 @@ void NIDAQThread::initialize (bool signalChainIsLoading)
     //editor->initialize(signalChainIsLoading);
 }
 
+String NIDAQThread::getMetrics()
+{
+    const ScopedLock lock (devicesLock);
+
+    Array<NIDAQmx*> devices;
+
+    for (auto* nidaq : mNIDAQs)
+        devices.add (nidaq);
+
+    return formatMetrics (devices);
+}
+
+/* "STATS" replies with one line per acquired device:
+   <device> rate=<S/s> reads= samples= bytes= read_ms= convert_ms= publish_ms= overflows= restarts= max_loop_us=
+   "METRICS [port]" serves Prometheus metrics on 127.0.0.1 (DEFAULT_METRICS_PORT without a port), "METRICS OFF" stops */
 String NIDAQThread::handleConfigMessage (const String& msg)
 {
-    //TODO:
-    return " ";
+    const StringArray tokens = StringArray::fromTokens (msg.trim(), " ", "");
+
+    if (tokens[0].equalsIgnoreCase ("METRICS"))
+    {
+        if (tokens[1].equalsIgnoreCase ("OFF"))
+        {
+            setMetricsPort (0);
+            return "OK metrics off";
+        }
+
+        const int port = tokens[1].isEmpty() ? DEFAULT_METRICS_PORT : tokens[1].getIntValue();
+
+        if (! tokens[1].containsOnly ("0123456789") || port < 1 || port > 65535 || ! setMetricsPort (port))
+            return "ERROR could not serve metrics on 127.0.0.1:" + tokens[1];
+
+        return "OK http://127.0.0.1:" + String (port) + "/metrics";
+    }
+
+    if (! tokens[0].equalsIgnoreCase ("STATS"))
+        return " ";
+
+    StringArray lines;
+
+    for (auto* nidaq : mNIDAQs)
+    {
+        const AcquisitionStats& stats = nidaq->getStats();
+
+        lines.add (nidaq->device->getName()
+                   + " rate=" + String (nidaq->getSampleRate())
+                   + " reads=" + String (stats.getReads())
+                   + " samples=" + String (stats.getSamples())
+                   + " bytes=" + String (stats.getBytes())
+                   + " read_ms=" + String (stats.getReadSeconds() * 1e3, 1)
+                   + " convert_ms=" + String (stats.getConversionSeconds() * 1e3, 1)
+                   + " publish_ms=" + String (stats.getPublishSeconds() * 1e3, 1)
+                   + " overflows=" + String (stats.getOverflows())
+                   + " restarts=" + String (stats.getRestarts())
+                   + " max_loop_us=" + String (roundToInt (stats.getMaxLoopSeconds() * 1e6)));
+    }
+
+    return lines.joinIntoString ("\n");
 }
 
 void NIDAQThread::handleBroadcastMessage (const String& msg, const int64 systemTimeMillis)
@@ -83,33 +141,60 @@ void NIDAQThread::updateSettings (OwnedArray<ContinuousChannel>* continuousChann
     if (! foundInputSource())
         return;
 
-    if (sourceStreams.size() == 0) // initialize data streams
+    /* One stream per acquired device, followed by one per device with a decimated copy
+       (sourceBuffers keeps the same order). Rebuilt when the devices or their sample rates change */
+    Array<NIDAQmx*> streamDevices;
+    Array<float> streamRates;
+
+    for (auto nidaq : mNIDAQs)
     {
-        DataStream::Settings settings {
-            getProductName(),
-            "Analog input channels from a NIDAQ device",
-            "identifier",
+        streamDevices.add (nidaq);
+        streamRates.add (float (nidaq->getSampleRate()));
+    }
+
+    for (auto nidaq : mNIDAQs)
+    {
+        if (nidaq->getDecimationFactor() > 1)
+        {
+            streamDevices.add (nidaq);
+            streamRates.add (float (nidaq->getDecimatedSampleRate()));
+        }
+    }
 
-            getSampleRate()
+    bool streamsChanged = sourceStreams.size() != streamDevices.size();
 
-        };
+    for (int i = 0; i < sourceStreams.size() && ! streamsChanged; i++)
+        streamsChanged = sourceStreams[i]->getSampleRate() != streamRates[i];
 
-        sourceStreams.add (new DataStream (settings));
-    }
-    else if (sourceStreams[0]->getSampleRate() != getSampleRate())
+    if (streamsChanged)
     {
         sourceStreams.clear();
 
-        DataStream::Settings settings {
-            getProductName(),
-            "Analog input channels from a NIDAQ device",
-            "identifier",
+        for (int i = 0; i < streamDevices.size(); i++)
+        {
+            DataStream::Settings settings {
+                getStreamName (streamDevices[i], i >= mNIDAQs.size()),
+                i < mNIDAQs.size() ? "Analog input channels from a NIDAQ device"
+                                   : "Low-pass filtered and decimated analog input channels from a NIDAQ device",
+                "identifier",
 
-            getSampleRate()
+                streamRates[i]
 
-        };
+            };
+
+            sourceStreams.add (new DataStream (settings));
+        }
+    }
 
-        sourceStreams.add (new DataStream (settings));
+    /* Decimated buffers are recreated to match, after the per-device ones */
+    sourceBuffers.removeRange (mNIDAQs.size(), sourceBuffers.size());
+
+    for (auto nidaq : mNIDAQs)
+    {
+        nidaq->decimatedBuffer = nullptr;
+
+        if (nidaq->getDecimationFactor() > 1)
+            nidaq->decimatedBuffer = sourceBuffers.add (new DataBuffer (nidaq->getNumActiveAnalogInputs(), DATA_BUFFER_SIZE));
     }
 
     dataStreams->clear();
@@ -122,16 +207,17 @@ void NIDAQThread::updateSettings (OwnedArray<ContinuousChannel>* continuousChann
     for (int i = 0; i < sourceStreams.size(); i++)
     {
         DataStream* currentStream = sourceStreams[i];
+        NIDAQmx* nidaq = streamDevices[i];
 
-        currentStream->setName (getProductName());
+        currentStream->setName (getStreamName (nidaq, i >= mNIDAQs.size()));
 
         currentStream->clearChannels();
 
-        for (int ch = 0; ch < getNumActiveAnalogInputs(); ch++)
+        for (int ch = 0; ch < nidaq->getNumActiveAnalogInputs(); ch++)
         {
-            if (mNIDAQ->ai[ch]->isEnabled())
+            if (nidaq->ai[ch]->isEnabled())
             {
-                float bitVolts = mNIDAQ->getVoltageRange().max / float (0x7fff);
+                float bitVolts = nidaq->getBitVolts (ch, i >= mNIDAQs.size());
 
                 ContinuousChannel::Settings settings {
                     ContinuousChannel::Type::ADC,
@@ -150,11 +236,11 @@ void NIDAQThread::updateSettings (OwnedArray<ContinuousChannel>* continuousChann
 
         EventChannel::Settings settings {
             EventChannel::Type::TTL,
-            getProductName() + "Digital Input Line",
-            "Digital Line from a NIDAQ device containing " + String (mNIDAQ->di.size()) + " inputs",
+            nidaq->getProductName() + "Digital Input Line",
+            "Digital Line from a NIDAQ device containing " + String (nidaq->di.size()) + " inputs",
             "identifier",
             currentStream,
-            mNIDAQ->di.size()
+            nidaq->di.size()
         };
 
         eventChannels->add (new EventChannel (settings));
@@ -163,6 +249,25 @@ void NIDAQThread::updateSettings (OwnedArray<ContinuousChannel>* continuousChann
     }
 }
 
+String NIDAQThread::getStreamName (NIDAQmx* nidaq, bool decimated)
+{
+    String name = nidaq->getProductName();
+
+    for (auto other : mNIDAQs)
+    {
+        if (other != nidaq && other->getProductName() == nidaq->getProductName())
+        {
+            name += " (" + nidaq->device->getName() + ")";
+            break;
+        }
+    }
+
+    if (decimated)
+        name += " /" + String (nidaq->getDecimationFactor());
+
+    return name;
+}
+
 Array<NIDAQDevice*> NIDAQThread::getDevices()
 {
     Array<NIDAQDevice*> deviceList;
@@ -175,9 +280,15 @@ Array<NIDAQDevice*> NIDAQThread::getDevices()
 
 int NIDAQThread::openConnection()
 {
-    mNIDAQ = new NIDAQmx (dm->getDeviceAtIndex (0));
+    /* Devices are built and destroyed outside devicesLock, which only guards the array */
+    NIDAQmx* nidaq = new NIDAQmx (dm->getDeviceAtIndex (0));
+
+    {
+        const ScopedLock lock (devicesLock);
+        mNIDAQ = mNIDAQs.add (nidaq);
+    }
 
-    sourceBuffers.add (new DataBuffer (getNumActiveAnalogInputs(), 10000));
+    sourceBuffers.add (new DataBuffer (getNumActiveAnalogInputs(), DATA_BUFFER_SIZE));
 
     mNIDAQ->aiBuffer = sourceBuffers.getLast();
 
@@ -237,9 +348,10 @@ void NIDAQThread::selectFromAvailableDevices()
 
 void NIDAQThread::updateAnalogChannels()
 {
-    sourceBuffers.removeLast();
-    sourceBuffers.add (new DataBuffer (getNumActiveAnalogInputs(), 10000));
-    mNIDAQ->aiBuffer = sourceBuffers.getLast();
+    const int index = getFocusedDeviceIndex();
+
+    sourceBuffers.set (index, new DataBuffer (getNumActiveAnalogInputs(), DATA_BUFFER_SIZE));
+    mNIDAQ->aiBuffer = sourceBuffers[index];
 
     for (auto& channel : mNIDAQ->ai)
     {
@@ -269,11 +381,33 @@ int NIDAQThread::swapConnection (String deviceName)
 
         if (dev->getName() == deviceName)
         {
-            mNIDAQ = new NIDAQmx (dev);
+            /* A device is only ever acquired once, so swapping to an acquired one just focuses it */
+            if (isDeviceAcquired (deviceName))
+            {
+                for (int i = 0; i < mNIDAQs.size(); i++)
+                {
+                    if (mNIDAQs[i]->device == dev)
+                        setFocusedDevice (i);
+                }
+
+                return deviceIdx;
+            }
+
+            const int index = getFocusedDeviceIndex();
+
+            NIDAQmx* nidaq = new NIDAQmx (dev);
+            ScopedPointer<NIDAQmx> previous;
+
+            {
+                const ScopedLock lock (devicesLock);
+                previous = mNIDAQs[index];
+                mNIDAQ = mNIDAQs.set (index, nidaq, false);
+            }
+
+            previous = nullptr;
 
-            sourceBuffers.removeLast();
-            sourceBuffers.add (new DataBuffer (getNumActiveAnalogInputs(), 10000));
-            mNIDAQ->aiBuffer = sourceBuffers.getLast();
+            sourceBuffers.set (index, new DataBuffer (getNumActiveAnalogInputs(), DATA_BUFFER_SIZE));
+            mNIDAQ->aiBuffer = sourceBuffers[index];
 
             deviceIndex = deviceIdx;
             setDeviceIndex (deviceIndex);
@@ -295,6 +429,86 @@ int NIDAQThread::swapConnection (String deviceName)
     return deviceIdx;
 }
 
+bool NIDAQThread::isDeviceAcquired (String deviceName)
+{
+    for (auto nidaq : mNIDAQs)
+    {
+        if (nidaq->device->getName() == deviceName)
+            return true;
+    }
+
+    return false;
+}
+
+void NIDAQThread::setFocusedDevice (int index)
+{
+    if (index < 0 || index >= mNIDAQs.size())
+        return;
+
+    mNIDAQ = mNIDAQs[index];
+
+    deviceIndex = dm->getDeviceIndexFromName (mNIDAQ->device->getName());
+    sampleRateIndex = mNIDAQ->sampleRateIndex;
+    voltageRangeIndex = mNIDAQ->voltageRangeIndex;
+}
+
+int NIDAQThread::addDevice (String deviceName)
+{
+    NIDAQDevice* dev = dm->getDeviceFromName (deviceName);
+
+    if (dev == nullptr || isDeviceAcquired (deviceName))
+        return -1;
+
+    NIDAQmx* nidaq = new NIDAQmx (dev);
+
+    {
+        const ScopedLock lock (devicesLock);
+        mNIDAQ = mNIDAQs.add (nidaq);
+    }
+
+    /* Ahead of any decimated buffers, at the device's own index */
+    const int index = mNIDAQs.size() - 1;
+
+    sourceBuffers.insert (index, new DataBuffer (getNumActiveAnalogInputs(), DATA_BUFFER_SIZE));
+    mNIDAQ->aiBuffer = sourceBuffers[index];
+
+    deviceIndex = dm->getDeviceIndexFromName (deviceName);
+
+    sampleRateIndex = mNIDAQ->sampleRates.size() - 1;
+    setSampleRate (sampleRateIndex);
+
+    voltageRangeIndex = mNIDAQ->device->voltageRanges.size() - 1;
+    setVoltageRange (voltageRangeIndex);
+
+    sourceStreams.clear();
+
+    return index;
+}
+
+void NIDAQThread::removeDevice (int index)
+{
+    /* The last device stays, so the plugin always has something to show */
+    if (mNIDAQs.size() < 2 || index < 0 || index >= mNIDAQs.size())
+        return;
+
+    mNIDAQ = nullptr;
+
+    ScopedPointer<NIDAQmx> removed;
+
+    {
+        const ScopedLock lock (devicesLock);
+        removed = mNIDAQs.removeAndReturn (index);
+    }
+
+    removed = nullptr;
+
+    sourceBuffers.remove (index);
+
+    sourceStreams.clear();
+
+    setFocusedDevice (jmin (index, mNIDAQs.size() - 1));
+}
+
 void NIDAQThread::toggleSourceType (int id)
 {
     mNIDAQ->toggleSourceType (id);
@@ -338,6 +552,18 @@ void NIDAQThread::setSampleRate (int rateIndex)
     mNIDAQ->setSampleRate (rateIndex);
 }
 
+void NIDAQThread::setDecimationFactor (int factor)
+{
+    mNIDAQ->setDecimationFactor (factor);
+    sourceStreams.clear();
+}
+
+void NIDAQThread::setCustomSampleRate (double rate)
+{
+    mNIDAQ->setCustomSampleRate (rate);
+    sampleRateIndex = mNIDAQ->sampleRateIndex;
+}
+
 float NIDAQThread::getSampleRate()
 {
     return mNIDAQ->getSampleRate();
@@ -360,19 +586,56 @@ bool NIDAQThread::foundInputSource()
 
 XmlElement NIDAQThread::getInfoXml()
 {
-    //TODO:
     XmlElement nidaq_info ("NI-DAQmx");
     XmlElement* api_info = new XmlElement ("API");
     //api_info->setAttribute("version", api.version);
     nidaq_info.addChildElement (api_info);
 
+    /* Acquisition statistics of each device for the current (or last) run; times in seconds */
+    for (auto* nidaq : mNIDAQs)
+    {
+        const AcquisitionStats& stats = nidaq->getStats();
+
+        XmlElement* device_info = new XmlElement ("DEVICE");
+        device_info->setAttribute ("name", nidaq->device->getName());
+        device_info->setAttribute ("sample_rate", nidaq->getSampleRate());
+
+        XmlElement* stats_info = new XmlElement ("STATS");
+        stats_info->setAttribute ("reads", String (stats.getReads()));
+        stats_info->setAttribute ("samples", String (stats.getSamples()));
+        stats_info->setAttribute ("bytes", String (stats.getBytes()));
+        stats_info->setAttribute ("read_time", stats.getReadSeconds());
+        stats_info->setAttribute ("conversion_time", stats.getConversionSeconds());
+        stats_info->setAttribute ("publish_time", stats.getPublishSeconds());
+        stats_info->setAttribute ("overflows", String (stats.getOverflows()));
+        stats_info->setAttribute ("restarts", String (stats.getRestarts()));
+        stats_info->setAttribute ("max_loop_time", stats.getMaxLoopSeconds());
+
+        device_info->addChildElement (stats_info);
+        nidaq_info.addChildElement (device_info);
+    }
+
     return nidaq_info;
 }
 
 /** Initializes data transfer.*/
 bool NIDAQThread::startAcquisition()
 {
-    mNIDAQ->startThread();
+    for (int i = 0; i < mNIDAQs.size(); i++)
+    {
+        mNIDAQs[i]->setTraceAcquisition (traceAcquisition);
+        mNIDAQs[i]->setWriteLatencyHistograms (writeLatencyHistograms);
+        mNIDAQs[i]->createAcquisitionPlan();
+
+        if (! mNIDAQs[i]->startAcquisition())
+        {
+            /* Leave no device running if another one fails to start */
+            for (int j = 0; j < i; j++)
+                mNIDAQs[j]->stopAcquisition();
+
+            return false;
+        }
+    }
 
     return true;
 }
@@ -380,10 +643,9 @@ bool NIDAQThread::startAcquisition()
 /** Stops data transfer.*/
 bool NIDAQThread::stopAcquisition()
 {
-    if (mNIDAQ->isThreadRunning())
-    {
-        mNIDAQ->signalThreadShouldExit();
-    }
+    for (auto nidaq : mNIDAQs)
+        nidaq->stopAcquisition();
+
     return true;
 }
 
@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include "NIDAQComponents.h"
+#include "NIDAQMetrics.h"
 #include "nidaq-api/NIDAQmx.h"
 
 class SourceNode;
@@ -74,9 +75,24 @@ public:
     // Connect to first available device
     int openConnection();
 
-    // Helper method for loading...
+    // Replaces the focused device with another one (or focuses it if it is already acquired)
     int swapConnection (String productName);
 
+    // Devices acquired in parallel, each with its own acquisition thread, buffer and stream.
+    // The editor and the settings accessors below act on the focused device.
+    int getNumAcquiredDevices() { return mNIDAQs.size(); };
+    int getFocusedDeviceIndex() { return mNIDAQs.indexOf (mNIDAQ); };
+    void setFocusedDevice (int index);
+    bool isDeviceAcquired (String deviceName);
+    String getAcquiredDeviceName (int index) { return mNIDAQs[index]->device->getName(); };
+
+    // An acquired device by index, to read its settings without moving the focus
+    NIDAQmx* getAcquiredDevice (int index) { return mNIDAQs[index]; };
+
+    // Adds a device to acquire from and focuses it; returns its index, or -1
+    int addDevice (String deviceName);
+    void removeDevice (int index);
+
     /** Initializes data transfer.*/
     bool startAcquisition() override;
 
@@ -116,6 +132,110 @@ public:
     int getDigitalReadSize() { return mNIDAQ->getDigitalReadSize(); };
     void setDigitalReadSize (int size) { mNIDAQ->setDigitalReadSize (size); };
 
+    // Read native ADC counts and scale them in the plugin instead of in the driver
+    bool getUseRawSamples() { return mNIDAQ->getUseRawSamples(); };
+    void setUseRawSamples (bool useRawSamples) { mNIDAQ->setUseRawSamples (useRawSamples); };
+
+    // Read each block from a DAQmx callback instead of a dedicated acquisition thread
+    bool getUseCallbacks() { return mNIDAQ->getUseCallbacks(); };
+    void setUseCallbacks (bool useCallbacks) { mNIDAQ->setUseCallbacks (useCallbacks); };
+
+    // Target latency (ms) sets the samples per read; adaptive reads grow to drain a backlog
+    int getTargetLatencyMs() { return mNIDAQ->getTargetLatencyMs(); };
+    void setTargetLatencyMs (int targetLatencyMs) { mNIDAQ->setTargetLatencyMs (targetLatencyMs); };
+    bool getAdaptiveReads() { return mNIDAQ->getAdaptiveReads(); };
+    void setAdaptiveReads (bool adaptiveReads) { mNIDAQ->setAdaptiveReads (adaptiveReads); };
+
+    // Samples per channel in the most recent read (0 when not acquiring)
+    int getLastReadSize() { return mNIDAQ->getLastReadSize(); };
+
+    // Seconds of data the DAQmx host buffer can hold before it overflows
+    double getBufferSeconds() { return mNIDAQ->getBufferSeconds(); };
+    void setBufferSeconds (double bufferSeconds) { mNIDAQ->setBufferSeconds (bufferSeconds); };
+
+    // Host buffer size and its peak occupancy during the current (or last) run, in samples per channel
+    int getHostBufferSize() { return mNIDAQ->getHostBufferSize(); };
+    int getPeakBufferOccupancy() { return mNIDAQ->getPeakBufferOccupancy(); };
+    int getBufferOccupancy() { return mNIDAQ->getBufferOccupancy(); };
+
+    // DataBuffer fill level, and the peaks of both buffers since the last take (which resets them)
+    int getDataBufferFill() { return mNIDAQ->getDataBufferFill(); };
+    int getPeakDataBufferFill() { return mNIDAQ->getPeakDataBufferFill(); };
+    int takeRecentBufferPeak() { return mNIDAQ->takeRecentBufferPeak(); };
+    int takeRecentDataBufferPeak() { return mNIDAQ->takeRecentDataBufferPeak(); };
+
+    // Sample clock drift against the host clock (ppm) and RMS timestamp jitter (us)
+    double getClockDriftPpm() { return mNIDAQ->getClockDriftPpm(); };
+    double getTimestampJitter() { return mNIDAQ->getTimestampJitter(); };
+
+    // Save (sample index, host time) anchors of each run next to the recordings
+    bool getWriteClockAnchors() { return mNIDAQ->getWriteClockAnchors(); };
+    void setWriteClockAnchors (bool writeClockAnchors) { mNIDAQ->setWriteClockAnchors (writeClockAnchors); };
+
+    // Chrome trace of the acquisition loop phases, written next to the recordings when the run stops
+    // (for every device, applied when acquisition starts)
+    bool getTraceAcquisition() { return traceAcquisition; };
+    void setTraceAcquisition (bool traceAcquisition_) { traceAcquisition = traceAcquisition_; };
+
+    // Read duration, processing duration and read interval error histograms, optionally saved as CSV
+    const LatencyHistogram& getReadDurations() { return mNIDAQ->getReadDurations(); };
+    const LatencyHistogram& getProcessDurations() { return mNIDAQ->getProcessDurations(); };
+    const LatencyHistogram& getReadIntervalErrors() { return mNIDAQ->getReadIntervalErrors(); };
+    bool getWriteLatencyHistograms() { return writeLatencyHistograms; };
+    void setWriteLatencyHistograms (bool writeLatencyHistograms_) { writeLatencyHistograms = writeLatencyHistograms_; };
+
+    // Prometheus metrics for every acquired device on 127.0.0.1:port (0 turns the listener off)
+    bool setMetricsPort (int port) { return metricsServer->setPort (port); };
+    int getMetricsPort() { return metricsServer->getPort(); };
+    String getMetrics();
+
+    // Low-pass filtered copy of the analog inputs at 1/factor of the sample rate, published as
+    // an extra stream (factor 1 for none)
+    int getDecimationFactor() { return mNIDAQ->getDecimationFactor(); };
+    void setDecimationFactor (int factor);
+    int getDecimationTaps() { return mNIDAQ->getDecimationTaps(); };
+    void setDecimationTaps (int taps) { mNIDAQ->setDecimationTaps (taps); };
+
+    // High-pass cutoff and mains notch frequency (Hz, 0 for none) applied before publishing
+    double getHighPassCutoff() { return mNIDAQ->getHighPassCutoff(); };
+    void setHighPassCutoff (double cutoff) { mNIDAQ->setHighPassCutoff (cutoff); };
+    double getNotchFrequency() { return mNIDAQ->getNotchFrequency(); };
+    void setNotchFrequency (double frequency) { mNIDAQ->setNotchFrequency (frequency); };
+
+    // Reader/processing pipeline: blocks queued now and at peak, reads delayed by a full queue,
+    // and processing waits on an empty queue
+    int getQueueDepth() { return mNIDAQ->getQueueDepth(); };
+    int getPeakQueueDepth() { return mNIDAQ->getPeakQueueDepth(); };
+    int getReaderStalls() { return mNIDAQ->getReaderStalls(); };
+    int getProcessorWaits() { return mNIDAQ->getProcessorWaits(); };
+
+    // Scheduling for the reader and processing threads (cpuCore -1 leaves placement to the OS)
+    THREAD_PRIORITY getThreadPriority() { return mNIDAQ->getThreadPriority(); };
+    void setThreadPriority (THREAD_PRIORITY threadPriority) { mNIDAQ->setThreadPriority (threadPriority); };
+    int getCpuCore() { return mNIDAQ->getCpuCore(); };
+    void setCpuCore (int cpuCore) { mNIDAQ->setCpuCore (cpuCore); };
+
+    // Single-point (or 1 ms block) acquisition for closed-loop use, its late sample clock count,
+    // and the age of the oldest sample of each block when it is published, in microseconds
+    bool getLowLatency() { return mNIDAQ->getLowLatency(); };
+    void setLowLatency (bool lowLatency) { mNIDAQ->setLowLatency (lowLatency); };
+    int getLateSamples() { return mNIDAQ->getLateSamples(); };
+    int getMeanPublishLatency() { return mNIDAQ->getMeanPublishLatency(); };
+    int getMaxPublishLatency() { return mNIDAQ->getMaxPublishLatency(); };
+
+    // Task restarts after overflows or stalled reads, and the samples skipped over as gaps
+    int getNumRestarts() { return mNIDAQ->getNumRestarts(); };
+    int getNumGaps() { return mNIDAQ->getNumGaps(); };
+    int64 getLostSamples() { return mNIDAQ->getLostSamples(); };
+
+    // Mean and maximum deviation of the read interval from the data it returned, in microseconds
+    int getMeanReadJitter() { return mNIDAQ->getMeanReadJitter(); };
+    int getMaxReadJitter() { return mNIDAQ->getMaxReadJitter(); };
+
+    // Edges seen on a digital line since acquisition started
+    uint32 getRisingEdgeCount (int line) { return mNIDAQ->getRisingEdgeCount (line); };
+    uint32 getFallingEdgeCount (int line) { return mNIDAQ->getFallingEdgeCount (line); };
+
     // Returns the state of the digital ports to be used as input
     int getNumPorts() { return mNIDAQ->getNumPorts(); };
     bool getPortState (int portIdx) { return mNIDAQ->getPortState (portIdx); };
@@ -145,12 +265,21 @@ public:
     /** Sets the voltage range of the data source. */
     void setVoltageRange (int rangeIndex);
 
-    /** Sets the sample rate of the data source. */
+    /** Sets the sample rate of the data source from the preset list. */
     void setSampleRate (int rateIndex);
 
-    /** Returns the sample rate of the data source.*/
+    /** Sets any sample rate within the device's range. */
+    void setCustomSampleRate (double rate);
+
+    /** Returns the sample rate of the data source, as coerced by the driver.*/
     float getSampleRate();
 
+    /** Returns the sample rate that was asked for. */
+    double getRequestedSampleRate() { return mNIDAQ->getRequestedSampleRate(); };
+
+    /** Valid sample rates for the current channel count. */
+    SettingsRange getSampleRateRange() { return mNIDAQ->device->sampleRateRange; };
+
     /** Responds to broadcast messages sent during acquisition */
     void handleBroadcastMessage (const String& msg, const int64 systemTimeMillis) override;
 
@@ -177,12 +306,28 @@ private:
     /* Flag any available devices */
     bool inputAvailable;
 
-    /* Handle to current NIDAQ device */
-    ScopedPointer<NIDAQmx> mNIDAQ;
+    /* One acquisition per selected device; sourceBuffers and sourceStreams share its indices,
+       with the decimated streams and their buffers after the last device */
+    OwnedArray<NIDAQmx> mNIDAQs;
+
+    /* Device shown in the editor */
+    NIDAQmx* mNIDAQ = nullptr;
+
+    /* Held while mNIDAQs changes, and by the metrics thread while it reads the devices */
+    CriticalSection devicesLock;
+
+    ScopedPointer<NIDAQMetricsServer> metricsServer;
+
+    /* Diagnostics shared by all devices */
+    bool traceAcquisition = false;
+    bool writeLatencyHistograms = false;
 
     /* Array of source streams -- one per connected NIDAQ device */
     OwnedArray<DataStream> sourceStreams;
 
+    /* Stream name for a device (or its decimated copy), unique when several devices share a product name */
+    String getStreamName (NIDAQmx* nidaq, bool decimated = false);
+
     /* Selectable device properties */
     int deviceIndex = 0;
     int sampleRateIndex = -1;
@@ -0,0 +1,75 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "NIDAQTrace.h"
+
+void TraceRing::prepare (const String& threadName_, int threadId_, int capacity_)
+{
+    if (capacity != capacity_)
+    {
+        events.malloc (capacity_);
+        capacity = capacity_;
+    }
+
+    numAdded = 0;
+    threadName = threadName_;
+    threadId = threadId_;
+}
+
+bool writeChromeTrace (const File& file, const Array<const TraceRing*>& rings, int64 originTicks)
+{
+    file.deleteFile();
+
+    FileOutputStream stream (file);
+
+    if (stream.failedToOpen())
+        return false;
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+
+    for (auto* ring : rings)
+    {
+        /* Names the thread's track */
+        stream << (first ? "" : ",\n")
+               << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->getThreadId()
+               << ",\"args\":{\"name\":\"" << ring->getThreadName() << "\"}}";
+        first = false;
+
+        for (int i = 0; i < ring->getNumEvents(); i++)
+        {
+            const TraceRing::Event& event = ring->getEvent (i);
+            const double start = Time::highResolutionTicksToSeconds (event.startTicks - originTicks) * 1e6;
+            const double duration = Time::highResolutionTicksToSeconds (event.endTicks - event.startTicks) * 1e6;
+
+            stream << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->getThreadId()
+                   << ",\"ts\":" << String (start, 3) << ",\"dur\":" << String (duration, 3) << "}";
+        }
+    }
+
+    stream << "\n]}\n";
+    stream.flush();
+
+    return stream.getStatus().wasOk();
+}
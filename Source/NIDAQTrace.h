@@ -0,0 +1,135 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __NIDAQTRACE_H__
+#define __NIDAQTRACE_H__
+
+#include <DataThreadHeaders.h>
+
+/* Compiled out entirely when 0; when 1, tracing still costs only a null check until it is switched on */
+#ifndef NIDAQ_TRACING
+#define NIDAQ_TRACING 1
+#endif
+
+#define TRACE_RING_EVENTS 65536 // most recent phases kept per thread
+
+/**
+
+    Phases recorded by one thread, in a ring allocated before the run starts, so recording
+    a phase is a store and never allocates. Once full it keeps the most recent events.
+
+*/
+class TraceRing
+{
+public:
+    struct Event
+    {
+        const char* name; // string literal, never copied
+        int64 startTicks;
+        int64 endTicks;
+    };
+
+    /** Allocates the ring (unless it already has this capacity) and empties it */
+    void prepare (const String& threadName, int threadId, int capacity);
+
+    void add (const char* name, int64 startTicks, int64 endTicks) noexcept
+    {
+        Event& event = events[int (numAdded % uint64 (capacity))];
+        event.name = name;
+        event.startTicks = startTicks;
+        event.endTicks = endTicks;
+        numAdded++;
+    }
+
+    /** Events still held, and the i-th oldest of them */
+    int getNumEvents() const { return int (jmin (numAdded, uint64 (capacity))); }
+    const Event& getEvent (int i) const { return events[int ((numAdded - getNumEvents() + i) % uint64 (capacity))]; }
+
+    /** Events overwritten because the ring was full */
+    uint64 getNumDropped() const { return numAdded - getNumEvents(); }
+
+    const String& getThreadName() const { return threadName; }
+    int getThreadId() const { return threadId; }
+
+private:
+    HeapBlock<Event> events;
+    int capacity = 0;
+    uint64 numAdded = 0;
+    String threadName;
+    int threadId = 0;
+};
+
+/**
+
+    Times a phase of the acquisition loop into a ring, doing nothing when the ring is null.
+    next() ends the current phase and starts another at the same instant, so a sequence of
+    phases needs one object and no extra nesting.
+
+*/
+class TraceScope
+{
+public:
+    TraceScope (TraceRing* ring_, const char* name_) noexcept : ring (ring_), name (name_)
+    {
+        if (ring != nullptr)
+            startTicks = Time::getHighResolutionTicks();
+    }
+
+    ~TraceScope()
+    {
+        if (ring != nullptr)
+            ring->add (name, startTicks, Time::getHighResolutionTicks());
+    }
+
+    void next (const char* nextName) noexcept
+    {
+        if (ring == nullptr)
+            return;
+
+        const int64 now = Time::getHighResolutionTicks();
+        ring->add (name, startTicks, now);
+
+        name = nextName;
+        startTicks = now;
+    }
+
+private:
+    TraceRing* ring;
+    const char* name;
+    int64 startTicks = 0;
+};
+
+/* One scope per block: NIDAQ_TRACE_SCOPE opens it, NIDAQ_TRACE_NEXT moves it to the next phase */
+#if NIDAQ_TRACING
+#define NIDAQ_TRACE_SCOPE(ring, name) TraceScope traceScope (ring, name)
+#define NIDAQ_TRACE_NEXT(name) traceScope.next (name)
+#else
+#define NIDAQ_TRACE_SCOPE(ring, name)
+#define NIDAQ_TRACE_NEXT(name)
+#endif
+
+/** Writes the rings as Chrome trace-event JSON (loads in chrome://tracing and Perfetto),
+    with times in microseconds from originTicks. Returns false if the file cannot be written */
+bool writeChromeTrace (const File& file, const Array<const TraceRing*>& rings, int64 originTicks);
+
+#endif
@@ -0,0 +1,126 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+
+#include <math.h>
+
+/* Every SIMD level must filter exactly as the scalar path does, across block boundaries
+   (the state carries over), and the designed sections must do what their names say */
+
+static std::vector<float> filter (SIMD_LEVEL level, int numChannels, const std::vector<BiquadBank::Section>& sections, std::vector<float> scans, int blockScans)
+{
+    const int numScans = int (scans.size() / numChannels);
+
+    BiquadBank bank;
+    bank.setSIMDLevel (level);
+    bank.prepare (numChannels, sections.data(), (int) sections.size());
+
+    for (int start = 0; start < numScans; start += blockScans)
+        bank.process (scans.data() + (size_t) start * numChannels, blockScans < numScans - start ? blockScans : numScans - start);
+
+    return scans;
+}
+
+/* Peak of the second half of one channel, once the filter has settled */
+static float getSettledPeak (const std::vector<float>& scans, int numChannels, int channel)
+{
+    const size_t numScans = scans.size() / numChannels;
+    float peak = 0;
+
+    for (size_t i = numScans / 2; i < numScans; i++)
+        peak = fabsf (scans[i * numChannels + channel]) > peak ? fabsf (scans[i * numChannels + channel]) : peak;
+
+    return peak;
+}
+
+static void testMatchesScalar (const std::vector<SIMD_LEVEL>& levels)
+{
+    const double sampleRate = 30000.0;
+    const std::vector<std::vector<BiquadBank::Section>> banks = {
+        { BiquadBank::highPass (300.0, sampleRate) },
+        { BiquadBank::highPass (1.0, sampleRate), BiquadBank::notch (50.0, sampleRate, 30.0) },
+        { BiquadBank::highPass (300.0, sampleRate), BiquadBank::notch (60.0, sampleRate, 30.0),
+          BiquadBank::notch (120.0, sampleRate, 30.0), BiquadBank::notch (180.0, sampleRate, 30.0) },
+    };
+    const int blockSizes[] = { 1, 7, 300 };
+    const int numScans = 2000;
+
+    TestRandom random (8);
+
+    for (int numChannels = 1; numChannels <= 80; numChannels++)
+    {
+        std::vector<float> in ((size_t) numScans * numChannels);
+        for (auto& value : in)
+            value = random.nextFloat();
+
+        for (const auto& sections : banks)
+        {
+            const std::vector<float> reference = filter (SIMD_SCALAR, numChannels, sections, in, numScans);
+
+            for (int blockScans : blockSizes)
+            {
+                EXPECT (bitIdentical (filter (SIMD_SCALAR, numChannels, sections, in, blockScans), reference),
+                        "scalar, %d-scan blocks, %d channels, %d sections", blockScans, numChannels, (int) sections.size());
+
+                for (SIMD_LEVEL level : levels)
+                    EXPECT (bitIdentical (filter (level, numChannels, sections, in, blockScans), reference),
+                            "%s, %d-scan blocks, %d channels, %d sections", getSIMDLevelName (level), blockScans, numChannels, (int) sections.size());
+            }
+        }
+    }
+}
+
+static void testResponse()
+{
+    const double pi = 3.14159265358979323846;
+    const double sampleRate = 30000.0;
+    const int numChannels = 3;
+    const int numScans = 60000;
+
+    /* Channel 0: DC offset; channel 1: 50 Hz mains; channel 2: 1 kHz signal */
+    std::vector<float> in ((size_t) numScans * numChannels);
+    for (int i = 0; i < numScans; i++)
+    {
+        in[(size_t) i * numChannels] = 1.0f;
+        in[(size_t) i * numChannels + 1] = float (sin (2.0 * pi * 50.0 * i / sampleRate));
+        in[(size_t) i * numChannels + 2] = float (sin (2.0 * pi * 1000.0 * i / sampleRate));
+    }
+
+    const std::vector<BiquadBank::Section> sections = { BiquadBank::highPass (10.0, sampleRate), BiquadBank::notch (50.0, sampleRate, 30.0) };
+    const std::vector<float> out = filter (getSupportedSIMDLevel(), numChannels, sections, in, 300);
+
+    EXPECT (getSettledPeak (out, numChannels, 0) < 1.0e-3f, "DC left %.5f", getSettledPeak (out, numChannels, 0));
+    EXPECT (getSettledPeak (out, numChannels, 1) < 0.02f, "50 Hz left %.5f", getSettledPeak (out, numChannels, 1));
+    EXPECT (fabs (getSettledPeak (out, numChannels, 2) - 1.0f) < 0.01f, "1 kHz gain %.5f", getSettledPeak (out, numChannels, 2));
+}
+
+int main()
+{
+    const std::vector<SIMD_LEVEL> levels = getTestedSIMDLevels();
+
+    testMatchesScalar (levels);
+    testResponse();
+
+    return finishTest ("BiquadBankTest");
+}
@@ -0,0 +1,152 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+
+#include <math.h>
+
+/* Every SIMD level must give the scalar output bit for bit however the input is split into
+   blocks (the history and output phase carry over), and the filter has to pass DC and stop
+   what would alias */
+
+static const int maxBlockScans = 512;
+
+struct Decimated
+{
+    std::vector<float> scans;
+    std::vector<int> inputIndices; /* relative to the start of the whole input */
+};
+
+static Decimated decimate (SIMD_LEVEL level, int numChannels, int factor, int numTaps, const std::vector<float>& in, int blockScans)
+{
+    const int numScans = int (in.size() / numChannels);
+
+    Decimator decimator;
+    decimator.setSIMDLevel (level);
+    decimator.prepare (numChannels, factor, numTaps, maxBlockScans);
+
+    Decimated result;
+    std::vector<float> out ((size_t) (maxBlockScans / factor + 1) * numChannels);
+    std::vector<int> indices (maxBlockScans / factor + 1);
+
+    for (int start = 0; start < numScans; start += blockScans)
+    {
+        const int count = blockScans < numScans - start ? blockScans : numScans - start;
+        const int phase = decimator.getPhase();
+        const int numOut = decimator.process (in.data() + (size_t) start * numChannels, count, out.data(), indices.data());
+
+        /* The phase is where the block's first output falls (what a gap is measured against) */
+        EXPECT (numOut > 0 ? indices[0] == phase : phase >= count, "phase %d, %d-scan block", phase, count);
+
+        result.scans.insert (result.scans.end(), out.begin(), out.begin() + (size_t) numOut * numChannels);
+        for (int i = 0; i < numOut; i++)
+            result.inputIndices.push_back (start + indices[i]);
+    }
+
+    return result;
+}
+
+static void testMatchesScalar (const std::vector<SIMD_LEVEL>& levels)
+{
+    const int factors[] = { 2, 5, 30 };
+    const int tapCounts[] = { 1, 16, 63 };
+    const int blockSizes[] = { 1, 7, 100, 512 };
+    const int numScans = 3000;
+
+    TestRandom random (7);
+
+    for (int numChannels = 1; numChannels <= 80; numChannels += (numChannels < 20 ? 1 : 13))
+    {
+        for (int factor : factors)
+        {
+            for (int numTaps : tapCounts)
+            {
+                std::vector<float> in ((size_t) numScans * numChannels);
+                for (auto& value : in)
+                    value = random.nextFloat();
+
+                const Decimated reference = decimate (SIMD_SCALAR, numChannels, factor, numTaps, in, maxBlockScans);
+
+                /* One output per factor inputs, covering the factor-th, 2 * factor-th... input */
+                bool indicesValid = (int) reference.inputIndices.size() == numScans / factor;
+                for (size_t i = 0; indicesValid && i < reference.inputIndices.size(); i++)
+                    indicesValid = reference.inputIndices[i] == int (i + 1) * factor - 1;
+                EXPECT (indicesValid, "indices, %d channels, factor %d, %d taps", numChannels, factor, numTaps);
+
+                for (int blockScans : blockSizes)
+                {
+                    const Decimated scalar = decimate (SIMD_SCALAR, numChannels, factor, numTaps, in, blockScans);
+                    EXPECT (bitIdentical (scalar.scans, reference.scans) && scalar.inputIndices == reference.inputIndices,
+                            "scalar, %d-scan blocks, %d channels, factor %d, %d taps", blockScans, numChannels, factor, numTaps);
+
+                    for (SIMD_LEVEL level : levels)
+                    {
+                        const Decimated result = decimate (level, numChannels, factor, numTaps, in, blockScans);
+
+                        EXPECT (bitIdentical (result.scans, reference.scans) && result.inputIndices == reference.inputIndices,
+                                "%s, %d-scan blocks, %d channels, factor %d, %d taps", getSIMDLevelName (level), blockScans, numChannels, factor, numTaps);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void testResponse()
+{
+    const int numChannels = 4;
+    const int factor = 10;
+    const int numTaps = 64;
+    const int numScans = 4000;
+
+    /* DC passes with unit gain once the history is full */
+    std::vector<float> in ((size_t) numScans * numChannels, 1.0f);
+    Decimated result = decimate (getSupportedSIMDLevel(), numChannels, factor, numTaps, in, 100);
+
+    EXPECT (fabs (result.scans.back() - 1.0f) < 1.0e-4f, "DC gain %.6f", result.scans.back());
+
+    const double pi = 3.14159265358979323846;
+
+    /* A tone well above the decimated Nyquist frequency (0.05 of the input rate) is stopped */
+    for (int i = 0; i < numScans; i++)
+        for (int c = 0; c < numChannels; c++)
+            in[(size_t) i * numChannels + c] = float (sin (2.0 * pi * 0.3 * i + c));
+
+    result = decimate (getSupportedSIMDLevel(), numChannels, factor, numTaps, in, 100);
+
+    float peak = 0;
+    for (size_t i = result.scans.size() / 2; i < result.scans.size(); i++)
+        peak = fabsf (result.scans[i]) > peak ? fabsf (result.scans[i]) : peak;
+
+    EXPECT (peak < 0.01f, "stopband peak %.4f", peak);
+}
+
+int main()
+{
+    const std::vector<SIMD_LEVEL> levels = getTestedSIMDLevels();
+
+    testMatchesScalar (levels);
+    testResponse();
+
+    return finishTest ("DecimatorTest");
+}
@@ -0,0 +1,107 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __KERNELTEST_H__
+#define __KERNELTEST_H__
+
+#include "NIDAQKernels.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/* Minimal harness shared by the kernel tests: each test is its own executable and
+   returns non-zero when any check failed, which is all ctest looks at. */
+
+static int numFailures = 0;
+
+#define EXPECT(condition, ...)                                          \
+    do                                                                  \
+    {                                                                   \
+        if (! (condition))                                              \
+        {                                                               \
+            numFailures++;                                              \
+            printf ("%s:%d: FAILED %s: ", __FILE__, __LINE__, #condition); \
+            printf (__VA_ARGS__);                                       \
+            printf ("\n");                                              \
+        }                                                               \
+    } while (0)
+
+/* Compares the bit patterns, so -0.0 vs 0.0 and differently rounded values both count */
+template <typename T>
+static bool bitIdentical (const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp (a.data(), b.data(), a.size() * sizeof (T)) == 0);
+}
+
+/* Deterministic xorshift generator, so a failure reproduces on every machine */
+class TestRandom
+{
+public:
+    explicit TestRandom (uint32_t seed = 0x9e3779b9u) : state (seed != 0 ? seed : 1) {}
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /* Uniform in [-1, 1) */
+    float nextFloat() { return float (next() >> 8) / float (1 << 23) - 1.0f; }
+
+    int nextInt (int limit) { return int (next() % uint32_t (limit)); }
+
+private:
+    uint32_t state;
+};
+
+/* Vector levels to compare against SIMD_SCALAR; levels above the CPU's would be clamped
+   to it by setSIMDLevel, so only the supported ones are run (and reported) */
+static std::vector<SIMD_LEVEL> getTestedSIMDLevels()
+{
+    std::vector<SIMD_LEVEL> levels;
+
+    for (int level = SIMD_SSE2; level <= getSupportedSIMDLevel(); level++)
+        levels.push_back ((SIMD_LEVEL) level);
+
+    printf ("Comparing against scalar:");
+    for (SIMD_LEVEL level : levels)
+        printf (" %s", getSIMDLevelName (level));
+    printf (levels.empty() ? " (no vector levels on this CPU)\n" : "\n");
+
+    return levels;
+}
+
+static int finishTest (const char* name)
+{
+    if (numFailures == 0)
+        printf ("%s passed\n", name);
+    else
+        printf ("%s: %d check(s) failed\n", name, numFailures);
+
+    return numFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+#include "NIDAQMetricsFormat.h"
+
+#include <map>
+#include <set>
+#include <sstream>
+
+/* The scrape text for known snapshots: exact sample lines, one HELP and TYPE per family
+   ahead of its samples, and label values escaped so every line still parses */
+
+static std::vector<std::string> splitLines (const std::string& text)
+{
+    std::vector<std::string> lines;
+    std::istringstream stream (text);
+    std::string line;
+
+    while (std::getline (stream, line))
+        lines.push_back (line);
+
+    return lines;
+}
+
+static bool contains (const std::vector<std::string>& lines, const std::string& line)
+{
+    for (const std::string& l : lines)
+    {
+        if (l == line)
+            return true;
+    }
+
+    return false;
+}
+
+/* Family a sample belongs to: summaries also own their _sum and _count series */
+static std::string familyOf (const std::string& metric, const std::map<std::string, std::string>& types)
+{
+    for (const char* suffix : { "_sum", "_count" })
+    {
+        const size_t length = strlen (suffix);
+
+        if (metric.size() > length && metric.compare (metric.size() - length, length, suffix) == 0)
+        {
+            const std::string base = metric.substr (0, metric.size() - length);
+            auto type = types.find (base);
+
+            if (type != types.end() && type->second == "summary")
+                return base;
+        }
+    }
+
+    return metric;
+}
+
+int main()
+{
+    DeviceMetrics first;
+    first.name = "Dev1";
+    first.sampleRate = 30000;
+    first.samples = 1500000;
+    first.reads = 2500;
+    first.bytes = 48000000;
+    first.hostBufferBacklog = 120;
+    first.hostBufferSize = 60000;
+    first.dataBufferFill = 600;
+    first.overflows = 1;
+    first.restarts = 2;
+    first.lostSamples = 4500;
+    first.readP50 = 0.0005;
+    first.readP99 = 0.002;
+    first.readP999 = 0.0125;
+    first.readSeconds = 1.25;
+    first.readerCpuSeconds = 0.75;
+    first.processingCpuSeconds = 1.5;
+
+    DeviceMetrics second;
+    second.name = "PXI1Slot2 \"left\\right\"\nrack";
+    second.sampleRate = 1000.5;
+
+    const std::string text = formatMetrics ({ first, second });
+    const std::vector<std::string> lines = splitLines (text);
+
+    EXPECT (! text.empty() && text.back() == '\n', "the text must end with a newline");
+
+    /* Exact samples for the first device */
+    const char* expected[] = {
+        "# HELP nidaq_sample_rate_hz Sample clock rate the driver runs at.",
+        "# TYPE nidaq_sample_rate_hz gauge",
+        "nidaq_sample_rate_hz{device=\"Dev1\"} 30000",
+        "# TYPE nidaq_samples_total counter",
+        "nidaq_samples_total{device=\"Dev1\"} 1500000",
+        "nidaq_reads_total{device=\"Dev1\"} 2500",
+        "nidaq_read_bytes_total{device=\"Dev1\"} 48000000",
+        "nidaq_host_buffer_backlog_samples{device=\"Dev1\"} 120",
+        "nidaq_host_buffer_size_samples{device=\"Dev1\"} 60000",
+        "nidaq_data_buffer_fill_samples{device=\"Dev1\"} 600",
+        "nidaq_overflows_total{device=\"Dev1\"} 1",
+        "nidaq_restarts_total{device=\"Dev1\"} 2",
+        "nidaq_lost_samples_total{device=\"Dev1\"} 4500",
+        "# TYPE nidaq_read_duration_seconds summary",
+        "nidaq_read_duration_seconds{device=\"Dev1\",quantile=\"0.5\"} 0.0005",
+        "nidaq_read_duration_seconds{device=\"Dev1\",quantile=\"0.99\"} 0.002",
+        "nidaq_read_duration_seconds{device=\"Dev1\",quantile=\"0.999\"} 0.0125",
+        "nidaq_read_duration_seconds_sum{device=\"Dev1\"} 1.25",
+        "nidaq_read_duration_seconds_count{device=\"Dev1\"} 2500",
+        "# TYPE nidaq_thread_cpu_seconds_total counter",
+        "nidaq_thread_cpu_seconds_total{device=\"Dev1\",thread=\"reader\"} 0.75",
+        "nidaq_thread_cpu_seconds_total{device=\"Dev1\",thread=\"processing\"} 1.5",
+    };
+
+    for (const char* line : expected)
+        EXPECT (contains (lines, line), "missing line: %s", line);
+
+    /* Label escaping: backslash, double quote and newline */
+    EXPECT (escapeMetricLabel ("a\\b\"c\nd") == "a\\\\b\\\"c\\nd", "escaped as %s", escapeMetricLabel ("a\\b\"c\nd").c_str());
+    EXPECT (contains (lines, "nidaq_sample_rate_hz{device=\"PXI1Slot2 \\\"left\\\\right\\\"\\nrack\"} 1000.5"), "second device label not escaped");
+
+    /* Structure: HELP then TYPE once per family, before any of its samples; every sample
+       has both devices, a parseable value and a valid metric name */
+    std::map<std::string, std::string> types;
+    std::set<std::string> helped;
+    std::map<std::string, int> samplesPerFamily;
+
+    for (const std::string& line : lines)
+    {
+        if (line.compare (0, 7, "# HELP ") == 0)
+        {
+            const std::string name = line.substr (7, line.find (' ', 7) - 7);
+            EXPECT (helped.insert (name).second, "HELP repeated for %s", name.c_str());
+            continue;
+        }
+
+        if (line.compare (0, 7, "# TYPE ") == 0)
+        {
+            const size_t nameEnd = line.find (' ', 7);
+            const std::string name = line.substr (7, nameEnd - 7);
+            const std::string type = line.substr (nameEnd + 1);
+
+            EXPECT (helped.count (name) == 1, "TYPE before HELP for %s", name.c_str());
+            EXPECT (types.count (name) == 0, "TYPE repeated for %s", name.c_str());
+            EXPECT (type == "gauge" || type == "counter" || type == "summary", "unknown type %s", type.c_str());
+            EXPECT (type != "counter" || (name.size() > 6 && name.compare (name.size() - 6, 6, "_total") == 0),
+                    "counter %s does not end in _total", name.c_str());
+
+            types[name] = type;
+            continue;
+        }
+
+        const size_t braces = line.find ('{');
+        const size_t valueStart = line.rfind ("} ");
+
+        EXPECT (braces != std::string::npos && valueStart != std::string::npos, "unparseable sample: %s", line.c_str());
+
+        if (braces == std::string::npos || valueStart == std::string::npos)
+            continue;
+
+        const std::string metric = line.substr (0, braces);
+        bool validName = ! metric.empty() && metric.compare (0, 6, "nidaq_") == 0;
+
+        for (char c : metric)
+            validName = validName && ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_');
+
+        EXPECT (validName, "invalid metric name %s", metric.c_str());
+
+        const std::string family = familyOf (metric, types);
+        EXPECT (types.count (family) == 1, "sample of %s before its TYPE", metric.c_str());
+
+        char* end = nullptr;
+        const std::string value = line.substr (valueStart + 2);
+        strtod (value.c_str(), &end);
+        EXPECT (! value.empty() && *end == 0, "value %s of %s is not a number", value.c_str(), metric.c_str());
+
+        samplesPerFamily[family]++;
+    }
+
+    for (const auto& family : types)
+    {
+        const int perDevice = family.second == "summary" ? 5 : family.first == "nidaq_thread_cpu_seconds_total" ? 2 : 1;
+        EXPECT (samplesPerFamily[family.first] == 2 * perDevice, "%s has %d samples", family.first.c_str(), samplesPerFamily[family.first]);
+    }
+
+    EXPECT (types.size() == 12, "%d families", (int) types.size());
+
+    /* No devices: the families are still declared, with no samples */
+    const std::vector<std::string> emptyLines = splitLines (formatMetrics ({}));
+    EXPECT (emptyLines.size() == 2 * types.size(), "%d lines without devices", (int) emptyLines.size());
+
+    return finishTest ("MetricsFormatTest");
+}
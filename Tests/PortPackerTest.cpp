@@ -0,0 +1,95 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+
+/* Every SIMD level must merge the per-port words exactly as the scalar path does, for any
+   port count and scan count, with ports at 32 bits or above dropped */
+
+static std::vector<uint32_t> pack (SIMD_LEVEL level, const std::vector<int>& shifts, const std::vector<uint32_t>& scans, int numScans)
+{
+    PortPacker packer;
+    packer.setSIMDLevel (level);
+    packer.prepare ((int) shifts.size(), shifts.data());
+
+    std::vector<uint32_t> out (numScans);
+    packer.pack (scans.data(), out.data(), numScans);
+    return out;
+}
+
+static std::vector<uint32_t> packReference (const std::vector<int>& shifts, const std::vector<uint32_t>& scans, int numScans)
+{
+    const int numPorts = (int) shifts.size();
+    std::vector<uint32_t> out (numScans, 0);
+
+    for (int i = 0; i < numScans; i++)
+    {
+        for (int p = 0; p < numPorts; p++)
+        {
+            if (shifts[p] < 32)
+                out[i] |= scans[(size_t) i * numPorts + p] << shifts[p];
+        }
+    }
+
+    return out;
+}
+
+int main()
+{
+    const std::vector<SIMD_LEVEL> levels = getTestedSIMDLevels();
+
+    /* Byte-wide ports as on most devices, a port past bit 31, and a 32-bit port 0 */
+    const std::vector<std::vector<int>> layouts = {
+        { 0 },
+        { 0, 8 },
+        { 0, 8, 16 },
+        { 0, 8, 16, 24 },
+        { 0, 8, 16, 24, 32 },
+        { 8, 0, 40, 24 },
+    };
+
+    TestRandom random (4);
+
+    for (const auto& shifts : layouts)
+    {
+        const int numPorts = (int) shifts.size();
+
+        for (int numScans = 0; numScans <= 80; numScans++)
+        {
+            /* Port words only use their low byte, except for the single 32-bit port */
+            std::vector<uint32_t> scans ((size_t) numScans * numPorts);
+            for (auto& word : scans)
+                word = numPorts == 1 ? random.next() : random.next() & 0xff;
+
+            const std::vector<uint32_t> scalar = pack (SIMD_SCALAR, shifts, scans, numScans);
+
+            EXPECT (scalar == packReference (shifts, scans, numScans), "scalar, %d ports, %d scans", numPorts, numScans);
+
+            for (SIMD_LEVEL level : levels)
+                EXPECT (pack (level, shifts, scans, numScans) == scalar,
+                        "%s, %d ports, %d scans", getSIMDLevelName (level), numPorts, numScans);
+        }
+    }
+
+    return finishTest ("PortPackerTest");
+}
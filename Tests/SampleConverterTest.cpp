@@ -0,0 +1,156 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+
+/* Every SIMD level must reproduce the scalar conversion bit for bit, for any channel count
+   (the per-channel patterns wrap at numChannels * 16, which rarely lines up with a vector) */
+
+static const int scanCounts[] = { 1, 3, 16, 17, 100 };
+
+static std::vector<uint32_t> makeMasks (TestRandom& random, int numChannels)
+{
+    std::vector<uint32_t> masks (numChannels);
+
+    for (auto& mask : masks)
+        mask = random.nextInt (4) != 0 ? 0xffffffffu : 0u;
+
+    return masks;
+}
+
+static std::vector<float> convertScaled (SIMD_LEVEL level, int numChannels, const std::vector<uint32_t>& masks, const std::vector<double>& in, int numScans)
+{
+    SampleConverter converter;
+    converter.setSIMDLevel (level);
+    converter.prepare (numChannels, masks.data());
+
+    std::vector<float> out ((size_t) numScans * numChannels);
+    converter.convert (in.data(), out.data(), numScans);
+    return out;
+}
+
+static std::vector<float> convertRaw (SIMD_LEVEL level, int numChannels, const std::vector<uint32_t>& masks, const std::vector<float>& coeffs, int numCoeffs, const std::vector<int16_t>& in, int numScans)
+{
+    SampleConverter converter;
+    converter.setSIMDLevel (level);
+    converter.prepare (numChannels, masks.data(), numCoeffs > 0 ? coeffs.data() : nullptr, numCoeffs);
+
+    std::vector<float> out ((size_t) numScans * numChannels);
+    converter.convert (in.data(), out.data(), numScans);
+    return out;
+}
+
+static void testScaled (const std::vector<SIMD_LEVEL>& levels)
+{
+    TestRandom random (1);
+
+    for (int numChannels = 1; numChannels <= 80; numChannels++)
+    {
+        const std::vector<uint32_t> masks = makeMasks (random, numChannels);
+
+        for (int numScans : scanCounts)
+        {
+            std::vector<double> in ((size_t) numScans * numChannels);
+            for (auto& value : in)
+                value = random.nextFloat() * 10.0 + random.nextFloat() * 1.0e-7;
+
+            const std::vector<float> reference = convertScaled (SIMD_SCALAR, numChannels, masks, in, numScans);
+
+            /* Scalar path against the definition: narrowed to float, zero for disabled channels */
+            bool matchesDefinition = true;
+            for (size_t i = 0; i < in.size(); i++)
+            {
+                const float expected = masks[i % numChannels] != 0 ? float (in[i]) : 0.0f;
+                matchesDefinition &= memcmp (&expected, &reference[i], sizeof (float)) == 0;
+            }
+            EXPECT (matchesDefinition, "scaled, %d channels, %d scans", numChannels, numScans);
+
+            for (SIMD_LEVEL level : levels)
+                EXPECT (bitIdentical (convertScaled (level, numChannels, masks, in, numScans), reference),
+                        "scaled, %s, %d channels, %d scans", getSIMDLevelName (level), numChannels, numScans);
+        }
+    }
+}
+
+static void testRaw (const std::vector<SIMD_LEVEL>& levels)
+{
+    TestRandom random (2);
+
+    for (int numCoeffs = 0; numCoeffs <= SampleConverter::maxCoeffs; numCoeffs++)
+    {
+        for (int numChannels = 1; numChannels <= 80; numChannels++)
+        {
+            const std::vector<uint32_t> masks = makeMasks (random, numChannels);
+
+            /* Offset, gain and small higher-order terms, like a device calibration */
+            std::vector<float> coeffs ((size_t) numChannels * numCoeffs);
+            for (size_t i = 0; i < coeffs.size(); i++)
+                coeffs[i] = random.nextFloat() * (i % numCoeffs == 0 ? 1.0e-2f : 3.0e-4f / float (1 << (2 * (i % numCoeffs))));
+
+            for (int numScans : scanCounts)
+            {
+                std::vector<int16_t> in ((size_t) numScans * numChannels);
+                for (auto& value : in)
+                    value = (int16_t) (random.next() & 0xffff);
+
+                const std::vector<float> reference = convertRaw (SIMD_SCALAR, numChannels, masks, coeffs, numCoeffs, in, numScans);
+
+                /* Scalar path against the definition: Horner's rule in float, highest order first */
+                bool matchesDefinition = true;
+                for (size_t i = 0; i < in.size(); i++)
+                {
+                    const int channel = int (i % numChannels);
+                    const float x = float (in[i]);
+
+                    float expected = 0.0f;
+                    if (numCoeffs > 0)
+                    {
+                        expected = coeffs[channel * numCoeffs + numCoeffs - 1];
+                        for (int n = numCoeffs - 2; n >= 0; n--)
+                            expected = expected * x + coeffs[channel * numCoeffs + n];
+                    }
+
+                    if (masks[channel] == 0)
+                        expected = 0.0f;
+
+                    matchesDefinition &= memcmp (&expected, &reference[i], sizeof (float)) == 0;
+                }
+                EXPECT (matchesDefinition, "raw, %d coeffs, %d channels, %d scans", numCoeffs, numChannels, numScans);
+
+                for (SIMD_LEVEL level : levels)
+                    EXPECT (bitIdentical (convertRaw (level, numChannels, masks, coeffs, numCoeffs, in, numScans), reference),
+                            "raw, %s, %d coeffs, %d channels, %d scans", getSIMDLevelName (level), numCoeffs, numChannels, numScans);
+            }
+        }
+    }
+}
+
+int main()
+{
+    const std::vector<SIMD_LEVEL> levels = getTestedSIMDLevels();
+
+    testScaled (levels);
+    testRaw (levels);
+
+    return finishTest ("SampleConverterTest");
+}
@@ -0,0 +1,117 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+
+#include <math.h>
+
+/* Per-sample timestamps: the clock fit has to recover a known drift from jittered read
+   times, and every SIMD level has to lay out the ramp exactly as the scalar path does */
+
+static void testRampFiller (const std::vector<SIMD_LEVEL>& levels)
+{
+    TestRandom random (5);
+
+    for (int count = 0; count <= 80; count++)
+    {
+        const double first = 1000.0 + random.nextFloat() * 1000.0;
+        const double step = (1.0 + random.nextFloat() * 1.0e-4) / 30000.0;
+
+        RampFiller filler;
+        filler.setSIMDLevel (SIMD_SCALAR);
+
+        std::vector<double> reference (count);
+        filler.fill (reference.data(), count, first, step);
+
+        /* Each value comes from its own index, not from adding step repeatedly */
+        bool matchesDefinition = true;
+        for (int i = 0; i < count; i++)
+            matchesDefinition &= reference[i] == first + double (i) * step;
+        EXPECT (matchesDefinition, "scalar, %d values", count);
+
+        for (SIMD_LEVEL level : levels)
+        {
+            filler.setSIMDLevel (level);
+
+            std::vector<double> out (count);
+            filler.fill (out.data(), count, first, step);
+
+            EXPECT (bitIdentical (out, reference), "%s, %d values", getSIMDLevelName (level), count);
+        }
+    }
+}
+
+static void testClockFit()
+{
+    const double nominalPeriod = 1.0 / 30000.0;
+    const double driftPpm = 50.0;
+    const double truePeriod = nominalPeriod * (1.0 + driftPpm * 1.0e-6);
+    const double jitter = 100.0e-6; /* uniform, so an RMS of jitter / sqrt (3) */
+    const int samplesPerRead = 300;
+    const int64_t firstSample = 1000000000000LL;
+
+    TestRandom random (6);
+    SampleClockFit fit;
+    fit.reset (nominalPeriod);
+
+    EXPECT (fit.getSamplePeriod() == nominalPeriod, "period before any anchor");
+    EXPECT (fit.getResidualRms() == 0, "residual before any anchor");
+
+    double lastTime = 0;
+    int64_t lastSample = firstSample;
+
+    for (int read = 0; read < 6000; read++) /* 60 s */
+    {
+        lastSample = firstSample + int64_t (read + 1) * samplesPerRead - 1;
+        lastTime = 5000.0 + double (lastSample - firstSample) * truePeriod;
+
+        fit.addAnchor (lastSample, lastTime + random.nextFloat() * jitter);
+
+        /* Read jitter would dominate the slope over a short span, so the nominal period holds */
+        if (double (lastSample - firstSample) * nominalPeriod < SampleClockFit::minFitSeconds)
+            EXPECT (fit.getSamplePeriod() == nominalPeriod, "period after %d anchors", read + 1);
+    }
+
+    EXPECT (fit.getNumAnchors() == 6000, "%lld anchors", (long long) fit.getNumAnchors());
+    EXPECT (fabs (fit.getDriftPpm() - driftPpm) < 1.0, "drift %.3f ppm, expected %.1f", fit.getDriftPpm(), driftPpm);
+    EXPECT (fabs (fit.getSamplePeriod() - truePeriod) < 1.0e-6 * nominalPeriod, "period %.12g, expected %.12g", fit.getSamplePeriod(), truePeriod);
+
+    const double expectedRms = jitter / sqrt (3.0);
+    EXPECT (fabs (fit.getResidualRms() - expectedRms) < 0.1 * expectedRms, "residual %.3g s, expected %.3g s", fit.getResidualRms(), expectedRms);
+
+    /* The fitted line averages the jitter out: well inside one read interval */
+    EXPECT (fabs (fit.getHostTime (lastSample) - lastTime) < 10.0e-6, "host time off by %.3g s", fit.getHostTime (lastSample) - lastTime);
+
+    fit.reset (nominalPeriod);
+    EXPECT (fit.getNumAnchors() == 0 && fit.getSamplePeriod() == nominalPeriod, "reset");
+}
+
+int main()
+{
+    const std::vector<SIMD_LEVEL> levels = getTestedSIMDLevels();
+
+    testRampFiller (levels);
+    testClockFit();
+
+    return finishTest ("TimestampTest");
+}
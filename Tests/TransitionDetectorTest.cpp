@@ -0,0 +1,137 @@
+/*
+    ------------------------------------------------------------------
+
+    This file is part of the Open Ephys GUI
+    Copyright (C) 2024 Open Ephys
+
+    ------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "KernelTest.h"
+
+/* Every SIMD level must report the same transitions as a plain sample-by-sample comparison,
+   including a change at sample 0 (against the previous block) and at the vector tails */
+
+struct Transitions
+{
+    std::vector<int> indices;
+    std::vector<uint32_t> words;
+};
+
+static Transitions detect (SIMD_LEVEL level, const std::vector<uint32_t>& codes, uint32_t mask, uint32_t previous)
+{
+    TransitionDetector detector;
+    detector.setSIMDLevel (level);
+
+    Transitions result;
+    result.indices.resize (codes.size());
+    result.words.resize (codes.size());
+
+    const int count = detector.detect (codes.data(), (int) codes.size(), mask, previous, result.indices.data(), result.words.data());
+
+    result.indices.resize (count);
+    result.words.resize (count);
+    return result;
+}
+
+static Transitions detectReference (const std::vector<uint32_t>& codes, uint32_t mask, uint32_t previous)
+{
+    Transitions result;
+
+    for (size_t i = 0; i < codes.size(); i++)
+    {
+        if ((codes[i] & mask) != previous)
+        {
+            result.indices.push_back ((int) i);
+            result.words.push_back (codes[i] & mask);
+        }
+
+        previous = codes[i] & mask;
+    }
+
+    return result;
+}
+
+/* Holds each word for a random run, changing with roughly the given probability (in percent) */
+static std::vector<uint32_t> makeCodes (TestRandom& random, int numSamples, int changePercent)
+{
+    std::vector<uint32_t> codes (numSamples);
+    uint32_t word = random.next();
+
+    for (auto& code : codes)
+    {
+        if (random.nextInt (100) < changePercent)
+            word ^= 1u << random.nextInt (32);
+
+        code = word;
+    }
+
+    return codes;
+}
+
+int main()
+{
+    const std::vector<SIMD_LEVEL> levels = getTestedSIMDLevels();
+    const uint32_t masks[] = { 0xffffffffu, 0x000000ffu, 0x00010001u, 0u };
+    const int changePercents[] = { 0, 2, 50, 100 };
+
+    TestRandom random (3);
+
+    for (int numSamples = 0; numSamples <= 80; numSamples++)
+    {
+        for (int changePercent : changePercents)
+        {
+            for (uint32_t mask : masks)
+            {
+                const std::vector<uint32_t> codes = makeCodes (random, numSamples, changePercent);
+
+                /* Previous (masked) word both equal to and different from the first sample */
+                const uint32_t first = numSamples > 0 ? codes[0] & mask : 0u;
+                const uint32_t previousWords[] = { first, ~first & mask };
+
+                for (uint32_t previous : previousWords)
+                {
+                    const Transitions expected = detectReference (codes, mask, previous);
+                    const Transitions scalar = detect (SIMD_SCALAR, codes, mask, previous);
+
+                    EXPECT (scalar.indices == expected.indices && scalar.words == expected.words,
+                            "scalar, %d samples, mask %08x, %d%% changes", numSamples, mask, changePercent);
+
+                    for (SIMD_LEVEL level : levels)
+                    {
+                        const Transitions result = detect (level, codes, mask, previous);
+
+                        EXPECT (result.indices == scalar.indices && result.words == scalar.words,
+                                "%s, %d samples, mask %08x, %d%% changes", getSIMDLevelName (level), numSamples, mask, changePercent);
+                    }
+                }
+            }
+        }
+    }
+
+    /* A long block, as read at high sample rates */
+    const std::vector<uint32_t> codes = makeCodes (random, 30000, 1);
+    const Transitions scalar = detect (SIMD_SCALAR, codes, 0xffffffffu, codes[0]);
+
+    for (SIMD_LEVEL level : levels)
+    {
+        const Transitions result = detect (level, codes, 0xffffffffu, codes[0]);
+        EXPECT (result.indices == scalar.indices && result.words == scalar.words, "%s, 30000 samples", getSIMDLevelName (level));
+    }
+
+    return finishTest ("TransitionDetectorTest");
+}